@@ -0,0 +1,51 @@
+// ctxbench: context switch cost, by pipe ping-pong.
+// Usage: ctxbench [n]
+// A parent and child pass a byte back and forth through two
+// pipes n times (default 2000).  Each round trip blocks and
+// wakes each side once, so on one CPU it is two context switches.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "x86.h"
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, ab[2], ba[2];
+  uint t0, dt;
+  char c;
+
+  n = argc > 1 ? atoi(argv[1]) : 2000;
+  if(n < 1)
+    n = 1;
+  if(pipe(ab) < 0 || pipe(ba) < 0){
+    printf(2, "ctxbench: pipe failed\n");
+    exit();
+  }
+
+  if(fork() == 0){
+    for(i = 0; i < n; i++){
+      if(read(ab[0], &c, 1) != 1)
+        break;
+      write(ba[1], &c, 1);
+    }
+    exit();
+  }
+
+  c = 'x';
+  t0 = (uint)rdtsc();
+  for(i = 0; i < n; i++){
+    write(ab[1], &c, 1);
+    if(read(ba[0], &c, 1) != 1){
+      printf(2, "ctxbench: child went away\n");
+      break;
+    }
+  }
+  dt = (uint)rdtsc() - t0;
+  wait();
+
+  printf(1, "%d round trips: %d cycles each, %d per switch\n",
+         n, dt / n, dt / (2*n));
+  exit();
+}
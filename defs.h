@@ -1,17 +1,24 @@
 struct buf;
 struct context;
 struct file;
+struct image;
 struct inode;
+struct memgrp;
+struct memstat;
 struct pipe;
 struct proc;
+struct procmemstat;
 struct rtcdate;
 struct spinlock;
 struct sleeplock;
 struct ticket_lock;
 struct semaphore;
 struct stat;
+struct sysrank;
+struct sysrec;
+struct sysstat;
+struct vma;
 struct superblock;
-struct node;
 struct rw_lock;
 struct wr_lock;
 
@@ -29,6 +36,8 @@ void            panic(char*) __attribute__((noreturn));
 
 // exec.c
 int             exec(char*, char**);
+int             loadimage(struct proc*, char*, char**, struct image*);
+void            setprocname(struct proc*, char*);
 
 // file.c
 struct file*    filealloc(void);
@@ -60,7 +69,8 @@ int             writei(struct inode*, char*, uint, uint);
 
 // ide.c
 void            ideinit(void);
-void            ideintr(void);
+void            ideintr(int);
+int             idepresent(int);
 void            iderw(struct buf*);
 
 // ioapic.c
@@ -69,14 +79,29 @@ extern uchar    ioapicid;
 void            ioapicinit(void);
 
 // kalloc.c
-char*           kalloc(void);
+char*           kalloc(int);
 void            kfree(char*);
+char*           kalloc_pages(int, int);
+char*           kalloc_zeroed(int);
+void            kzeroidle(void);
+void            kfree_pages(char*, int);
+void            ksplit(char*, int);
+void            kref(char*);
+int             krefcount(char*);
+uint            kfreecount(void);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
+void            kmemstat(struct memstat*);
 
 // kbd.c
 void            kbdintr(void);
 
+// kstack.c
+void            kstackinit(void);
+char*           kstackalloc(void);
+void            kstackfree(char*);
+int             kstackguard(uint);
+
 // lapic.c
 void            cmostime(struct rtcdate *r);
 int             lapicid(void);
@@ -92,10 +117,36 @@ void            log_write(struct buf*);
 void            begin_op();
 void            end_op();
 
+// mmap.c
+int             mmap(struct file*, uint, uint, int);
+int             munmap(uint, uint);
+int             vmafault(struct proc*, uint, uint);
+int             vmafork(struct proc*, struct proc*);
+uint            vmacommit(struct proc*);
+void            vmaclose(struct vma*);
+struct vma*     vmaoverlap(struct proc*, uint, uint);
+uint            vmaspace(struct proc*, uint, uint);
+
 // mp.c
 extern int      ismp;
 void            mpinit(void);
 
+// oom.c
+void            oominit(void);
+int             memadd(struct proc*, struct proc*, uint);
+void            memexit(struct proc*);
+int             memresize(struct proc*, uint, uint);
+struct memgrp*  memcharge(struct proc*, uint);
+void            memuncharge(struct memgrp*, uint);
+int             memlimit(uint, int);
+int             oomkill(struct proc*, int);
+
+// pcache.c
+void            pcinit(void);
+char*           pcget(struct inode*, uint);
+void            pcinval(struct inode*);
+void            pcstat(struct memstat*);
+
 // picirq.c
 void            picenable(int);
 void            picinit(void);
@@ -110,10 +161,12 @@ int             pipewrite(struct pipe*, char*, int);
 // proc.c
 int             invocation_log(int);
 int             get_syscall_count(int, int);
-void            log_syscalls(struct node*);
+int             getsysstat(int, struct sysstat*);
+int             settrace(int, int);
 int             cpuid(void);
 void            exit(void);
 int             fork(void);
+int             spawn(char*, char**, int*, int);
 int             growproc(int);
 int 			random(int);
 int 			totalTickets(void);
@@ -125,6 +178,10 @@ void			chpr(int,int);
 void 			chmfq(int,int);
 void			ps(void);
 void            pinit(void);
+void            kthread(char*, void (*)(void));
+struct proc*    lockptable(void);
+void            unlockptable(void);
+void            procmemstat(struct memstat*);
 void            procdump(void);
 void            scheduler(void) __attribute__((noreturn));
 void			MFQscheduler(void) __attribute__((noreturn));
@@ -137,6 +194,18 @@ int             wait(void);
 void            wakeup(void*);
 void            yield(void);
 
+// ring.c
+int             ringsetup(uint);
+int             ringenter(int);
+
+// swap.c
+void            swapinit(void);
+void            swapread(char*, uint);
+void            swapdup(uint);
+void            swapput(uint);
+int             swapwait(int);
+void            swapstat(struct memstat*);
+
 // swtch.S
 void            swtch(struct context**, struct context*);
 
@@ -145,6 +214,7 @@ void 			shminit(void);
 int 			shmopen(int id, int page_count, int flag);
 void* 			shmattach(int id);
 int 			shmclose(int id);
+void            shmexit(struct proc*);
 
 // spinlock.c
 void            acquire(struct spinlock*);
@@ -198,10 +268,20 @@ char*           strncpy(char*, const char*, int);
 // syscall.c
 int             argint(int, int*);
 int             argptr(int, char**, int);
+int             argoutptr(int, char**, int);
 int             argstr(int, char**);
 int             fetchint(uint, int*);
 int             fetchstr(uint, char**);
+char*           syscallname(int);
+void            printsysrec(int, struct sysrec*);
+int             sysrank(int, int, struct sysrank*, int);
 void            syscall(void);
+int             syscallat(int, uint);
+
+// trace.c
+void            traceinit(void);
+void            tracelog(int, int, int, int*, char*, int);
+void            traceprint(void);
 
 // timer.c
 void            timerinit(void);
@@ -210,6 +290,7 @@ void            timerinit(void);
 void            idtinit(void);
 extern uint     ticks;
 void            tvinit(void);
+void            doublefault(void);
 extern struct spinlock tickslock;
 
 // uart.c
@@ -223,6 +304,8 @@ int 		shm_allocuvm(pde_t *pgdir,char* pages[], uint amount_pages, int perm);
 void            seginit(void);
 void            kvmalloc(void);
 pde_t*          setupkvm(void);
+int             setupkinfo(pde_t*, struct proc*);
+void            kinfotick(void);
 char*           uva2ka(pde_t*, char*);
 int             allocuvm(pde_t*, uint, uint);
 int             deallocuvm(pde_t*, uint, uint);
@@ -230,10 +313,20 @@ void            freevm(pde_t*);
 void            inituvm(pde_t*, char*, uint);
 int             loaduvm(pde_t*, char*, struct inode*, uint, uint);
 pde_t*          copyuvm(pde_t*, uint);
+int             copyuvmrange(pde_t*, pde_t*, uint, uint);
+int             mapupage(pde_t*, uint, char*, int);
+int             uvmmapped(pde_t*, uint, uint);
+uint*           uvmpte(pde_t*, uint);
+void            uvmusage(pde_t*, struct procmemstat*);
+int             kstackmap(uint);
+int             prefault(struct proc*, uint, uint, int);
 void            switchuvm(struct proc*);
 void            switchkvm(void);
 int             copyout(pde_t*, uint, void*, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
+int             cowfault(pde_t*, uint);
+int             pagefault(struct proc*, uint, uint);
+uint            rsspages(pde_t*, uint);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
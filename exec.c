@@ -7,19 +7,29 @@
 #include "defs.h"
 #include "x86.h"
 #include "elf.h"
+#include "fcntl.h"
 
+// Load the program at path into a fresh page table for process p,
+// with argv on its stack, leaving p itself untouched.  On success
+// fills in img and returns 0.
+// Segments that are page-aligned in the file are not read here:
+// they become vmas in img, faulted in from the page cache as the
+// program touches them, so processes running the same program
+// share its pages.  The bss past the file data is left for
+// lazyfault().
 int
-exec(char *path, char **argv)
+loadimage(struct proc *p, char *path, char **argv, struct image *img)
 {
-  char *s, *last;
   int i, off;
   uint argc, sz, sp, ustack[3+MAXARG+1];
   struct elfhdr elf;
   struct inode *ip;
   struct proghdr ph;
-  pde_t *pgdir, *oldpgdir;
-  struct proc *curproc = myproc();
+  struct vma *v;
+  pde_t *pgdir;
 
+  memset(img->vma, 0, sizeof(img->vma));
+  v = img->vma;
   begin_op();
 
   if((ip = namei(path)) == 0){
@@ -38,6 +48,8 @@ exec(char *path, char **argv)
 
   if((pgdir = setupkvm()) == 0)
     goto bad;
+  if(setupkinfo(pgdir, p) < 0)
+    goto bad;
 
   // Load program into memory.
   sz = 0;
@@ -50,10 +62,29 @@ exec(char *path, char **argv)
       goto bad;
     if(ph.vaddr + ph.memsz < ph.vaddr)
       goto bad;
-    if((sz = allocuvm(pgdir, sz, ph.vaddr + ph.memsz)) == 0)
-      goto bad;
     if(ph.vaddr % PGSIZE != 0)
       goto bad;
+    if(ph.off % PGSIZE == 0 && ph.vaddr >= sz &&
+       ph.vaddr + ph.memsz < KERNBASE && v < &img->vma[NVMA]){
+      // Mapped copy-on-write even for text: xv6 programs have
+      // always been able to write anywhere below sz, and so has
+      // the kernel on their behalf.
+      if(ph.filesz > 0){
+        v->start = ph.vaddr;
+        v->fileend = ph.vaddr + ph.filesz;
+        v->end = PGROUNDUP(v->fileend);
+        if(ph.memsz == ph.filesz)
+          v->fileend = v->end;
+        v->off = ph.off;
+        v->prot = PROT_READ | PROT_WRITE;
+        v->ip = idup(ip);
+        v++;
+      }
+      sz = ph.vaddr + ph.memsz;
+      continue;
+    }
+    if((sz = allocuvm(pgdir, sz, ph.vaddr + ph.memsz)) == 0)
+      goto bad;
     if(loaduvm(pgdir, (char*)ph.vaddr, ip, ph.off, ph.filesz) < 0)
       goto bad;
   }
@@ -88,32 +119,65 @@ exec(char *path, char **argv)
   if(copyout(pgdir, sp, ustack, (3+argc+1)*4) < 0)
     goto bad;
 
-  // Save program name for debugging.
+  img->pgdir = pgdir;
+  img->sz = sz;
+  img->eip = elf.entry;  // main
+  img->esp = sp;
+  return 0;
+
+ bad:
+  if(pgdir)
+    freevm(pgdir);
+  if(ip){
+    iunlockput(ip);
+    end_op();
+  }
+  vmaclose(img->vma);
+  return -1;
+}
+
+// Set p's name from the last element of path, for debugging.
+void
+setprocname(struct proc *p, char *path)
+{
+  char *s, *last;
+
   for(last=s=path; *s; s++)
     if(*s == '/')
       last = s+1;
-  safestrcpy(curproc->name, last, sizeof(curproc->name));
+  safestrcpy(p->name, last, sizeof(p->name));
+}
+
+int
+exec(char *path, char **argv)
+{
+  struct image img;
+  pde_t *oldpgdir;
+  struct proc *curproc = myproc();
+
+  if(loadimage(curproc, path, argv, &img) < 0)
+    return -1;
+  if(memresize(curproc, curproc->sz + vmacommit(curproc), img.sz) < 0){
+    freevm(img.pgdir);
+    vmaclose(img.vma);
+    return -1;
+  }
+  setprocname(curproc, path);
 
   // Commit to the user image.
   oldpgdir = curproc->pgdir;
-  curproc->pgdir = pgdir;
-  curproc->sz = sz;
-  curproc->tf->eip = elf.entry;  // main
-  curproc->tf->esp = sp;
+  curproc->pgdir = img.pgdir;
+  curproc->sz = img.sz;
+  curproc->tf->eip = img.eip;
+  curproc->tf->esp = img.esp;
   // cmostime(&curproc->ctime);
   // curproc->priority = 10;
   // curproc->MFQpriority = 1;
   curproc->tickets = 500;
+  curproc->ringva = 0;
   switchuvm(curproc);
   freevm(oldpgdir);
+  vmaclose(curproc->vma);
+  memmove(curproc->vma, img.vma, sizeof(img.vma));
   return 0;
-
- bad:
-  if(pgdir)
-    freevm(pgdir);
-  if(ip){
-    iunlockput(ip);
-    end_op();
-  }
-  return -1;
 }
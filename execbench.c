@@ -0,0 +1,96 @@
+// execbench: time from exec() to the first instruction of main.
+// Usage: execbench [n]
+// Each child notes the TSC just before exec()ing this program,
+// which reads it again first thing in main and reports the
+// difference through a pipe.  The ballast below makes the
+// program big without the run ever touching it.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "x86.h"
+
+char ballast[32*1024] = { 1 };
+
+void
+utoa(uint x, char *buf)
+{
+  char tmp[16];
+  int i, n;
+
+  n = 0;
+  do {
+    tmp[n++] = '0' + x % 10;
+    x /= 10;
+  } while(x);
+  for(i = 0; i < n; i++)
+    buf[i] = tmp[n-1-i];
+  buf[n] = 0;
+}
+
+uint
+atou(char *s)
+{
+  uint n;
+
+  n = 0;
+  while('0' <= *s && *s <= '9')
+    n = n*10 + *s++ - '0';
+  return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint t1, dt, tot, min, max;
+  int i, n, fd[2];
+  char fdbuf[16], tbuf[16];
+  char *cargv[5];
+
+  t1 = (uint)rdtsc();
+  if(argc == 4 && strcmp(argv[1], "-x") == 0){
+    dt = t1 - atou(argv[3]);
+    write(atoi(argv[2]), &dt, sizeof(dt));
+    exit();
+  }
+
+  n = argc > 1 ? atoi(argv[1]) : 32;
+  if(n < 1)
+    n = 1;
+  if(pipe(fd) < 0){
+    printf(2, "execbench: pipe failed\n");
+    exit();
+  }
+  utoa(fd[1], fdbuf);
+
+  tot = max = 0;
+  min = ~0;
+  for(i = 0; i < n; i++){
+    if(fork() == 0){
+      close(fd[0]);
+      utoa((uint)rdtsc(), tbuf);
+      cargv[0] = "execbench";
+      cargv[1] = "-x";
+      cargv[2] = fdbuf;
+      cargv[3] = tbuf;
+      cargv[4] = 0;
+      exec(cargv[0], cargv);
+      printf(2, "execbench: exec failed\n");
+      exit();
+    }
+    wait();
+    if(read(fd[0], &dt, sizeof(dt)) != sizeof(dt)){
+      printf(2, "execbench: child did not report\n");
+      exit();
+    }
+    dt >>= 10;
+    tot += dt;
+    if(dt < min)
+      min = dt;
+    if(dt > max)
+      max = dt;
+  }
+  printf(1, "exec to main, %d runs (kcycles): avg %d min %d max %d\n",
+         n, tot / n, min, max);
+  exit();
+}
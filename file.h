@@ -16,6 +16,7 @@ struct inode {
   int ref;            // Reference count
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
+  int pcached;        // may have pages in the page cache (pcache.c)
 
   short type;         // copy of disk inode
   short major;
@@ -35,3 +36,4 @@ struct devsw {
 extern struct devsw devsw[];
 
 #define CONSOLE 1
+#define TRACE 2
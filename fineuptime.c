@@ -0,0 +1,28 @@
+// Linked into the user programs that time themselves in
+// fractions of a tick, rather than into every program with ulib.
+
+#include "types.h"
+#include "user.h"
+#include "x86.h"
+#include "kinfo.h"
+
+// uptime() in thousandths of a tick, interpolated with the TSC
+// since the last tick.  Whole ticks until the kernel has
+// calibrated the TSC, shortly after boot.
+uint
+fineuptime(void)
+{
+  struct kinfo *ki = (struct kinfo*)KINFO;
+  uint t, per, frac;
+  uint64 base, now;
+
+  do {
+    t = ki->ticks;
+    base = ki->ticktsc;
+    now = rdtsc();
+  } while(ki->ticks != t);
+  if((per = ki->tickcycles / 1000) == 0)
+    return t * 1000;
+  frac = (now - base) >> 32 ? 999 : (uint)(now - base) / per;
+  return t * 1000 + (frac > 999 ? 999 : frac);
+}
@@ -0,0 +1,77 @@
+// forkbench: fork latency as the parent's memory grows.
+// Usage: forkbench [nfork]
+// For each heap size, the parent times nfork forks whose
+// children exit at once, then the full round trip of one fork
+// whose child writes to every heap page before exiting, and
+// reports how long the whole run took.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "x86.h"
+
+#define PGSIZE 4096
+
+// Time one fork, from the call until it returns in the parent,
+// or until the child is reaped if it touches the heap.
+uint
+timefork(char *heap, int size, int touch)
+{
+  uint64 t0;
+  uint dt;
+  int i, pid;
+
+  t0 = rdtsc();
+  pid = fork();
+  dt = (rdtsc() - t0) >> 10;
+  if(pid < 0){
+    printf(2, "forkbench: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    if(touch)
+      for(i = 0; i < size; i += PGSIZE)
+        heap[i] = i;
+    exit();
+  }
+  wait();
+  if(touch)
+    dt = (rdtsc() - t0) >> 10;
+  return dt;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, kb, size;
+  uint tot, start;
+  char *heap;
+
+  n = argc > 1 ? atoi(argv[1]) : 16;
+  if(n < 1)
+    n = 1;
+
+  printf(1, "HEAP KB\tFORK KCYCLES\tTOUCH ROUND TRIP KCYCLES\n");
+  start = fineuptime();
+  size = 0;
+  for(kb = 0; kb <= 4096; kb = kb ? kb*4 : 64){
+    if(kb*1024 > size){
+      if(sbrk(kb*1024 - size) == (char*)-1){
+        printf(2, "forkbench: out of memory\n");
+        break;
+      }
+      size = kb*1024;
+    }
+    heap = sbrk(0) - size;
+    for(i = 0; i < size; i += PGSIZE)
+      heap[i] = 1;
+    tot = 0;
+    for(i = 0; i < n; i++)
+      tot += timefork(heap, size, 0);
+    printf(1, "%d\t%d\t\t%d\n", kb, tot / n, timefork(heap, size, 1));
+  }
+  tot = fineuptime() - start;
+  printf(1, "forkbench: %d.%d%d%d ticks\n", tot / 1000, tot / 100 % 10,
+         tot / 10 % 10, tot % 10);
+  exit();
+}
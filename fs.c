@@ -268,6 +268,7 @@ iget(uint dev, uint inum)
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
+  ip->pcached = 1;    // pages from its last time in the table may be left
   release(&icache.lock);
 
   return ip;
@@ -413,6 +414,7 @@ itrunc(struct inode *ip)
   struct buf *bp;
   uint *a;
 
+  pcinval(ip);
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
       bfree(ip->dev, ip->addrs[i]);
@@ -497,6 +499,8 @@ writei(struct inode *ip, char *src, uint off, uint n)
   if(off + n > MAXFILE*BSIZE)
     return -1;
 
+  if(n > 0)
+    pcinval(ip);
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
     bp = bread(ip->dev, bmap(ip, off/BSIZE));
     m = min(n - tot, BSIZE - off%BSIZE);
@@ -25,6 +25,12 @@
 #define IDE_CMD_RDMUL 0xc4
 #define IDE_CMD_WRMUL 0xc5
 
+// Disks 0 and 1 are on the primary channel, disk 2 (SWAPDEV)
+// is the master on the secondary channel.
+#define IDECHAN(dev)  ((dev) >= 2)
+#define IDEBASE(dev)  (IDECHAN(dev) ? 0x170 : 0x1f0)
+#define IDECTL(dev)   (IDECHAN(dev) ? 0x376 : 0x3f6)
+
 // idequeue points to the buf now being read/written to the disk.
 // idequeue->qnext points to the next buf to be processed.
 // You must hold idelock while manipulating queue.
@@ -33,15 +39,16 @@ static struct spinlock idelock;
 static struct buf *idequeue;
 
 static int havedisk1;
+static int havedisk2;
 static void idestart(struct buf*);
 
-// Wait for IDE disk to become ready.
+// Wait for the IDE channel of disk dev to become ready.
 static int
-idewait(int checkerr)
+idewait(int dev, int checkerr)
 {
   int r;
 
-  while(((r = inb(0x1f7)) & (IDE_BSY|IDE_DRDY)) != IDE_DRDY)
+  while(((r = inb(IDEBASE(dev) + 7)) & (IDE_BSY|IDE_DRDY)) != IDE_DRDY)
     ;
   if(checkerr && (r & (IDE_DF|IDE_ERR)) != 0)
     return -1;
@@ -55,7 +62,7 @@ ideinit(void)
 
   initlock(&idelock, "ide");
   ioapicenable(IRQ_IDE, ncpu - 1);
-  idewait(0);
+  idewait(0, 0);
 
   // Check if disk 1 is present
   outb(0x1f6, 0xe0 | (1<<4));
@@ -68,6 +75,33 @@ ideinit(void)
 
   // Switch back to disk 0.
   outb(0x1f6, 0xe0 | (0<<4));
+
+  // Check for the swap disk.  An empty channel reads as 0
+  // (or 0xff on a floating bus).
+  outb(0x176, 0xe0);
+  for(i=0; i<1000; i++){
+    if(inb(0x177) != 0 && inb(0x177) != 0xff){
+      havedisk2 = 1;
+      break;
+    }
+  }
+  if(havedisk2){
+    idewait(SWAPDEV, 0);
+    ioapicenable(IRQ_IDE2, ncpu - 1);
+  }
+}
+
+// Is disk dev attached?
+int
+idepresent(int dev)
+{
+  if(dev == 0)
+    return 1;
+  if(dev == 1)
+    return havedisk1;
+  if(dev == SWAPDEV)
+    return havedisk2;
+  return 0;
 }
 
 // Start the request for b.  Caller must hold idelock.
@@ -76,7 +110,7 @@ idestart(struct buf *b)
 {
   if(b == 0)
     panic("idestart");
-  if(b->blockno >= FSSIZE)
+  if(b->blockno >= (b->dev == SWAPDEV ? NSWAP*(PGSIZE/BSIZE) : FSSIZE))
     panic("incorrect blockno");
   int sector_per_block =  BSIZE/SECTOR_SIZE;
   int sector = b->blockno * sector_per_block;
@@ -85,39 +119,42 @@ idestart(struct buf *b)
 
   if (sector_per_block > 7) panic("idestart");
 
-  idewait(0);
-  outb(0x3f6, 0);  // generate interrupt
-  outb(0x1f2, sector_per_block);  // number of sectors
-  outb(0x1f3, sector & 0xff);
-  outb(0x1f4, (sector >> 8) & 0xff);
-  outb(0x1f5, (sector >> 16) & 0xff);
-  outb(0x1f6, 0xe0 | ((b->dev&1)<<4) | ((sector>>24)&0x0f));
+  int base = IDEBASE(b->dev);
+
+  idewait(b->dev, 0);
+  outb(IDECTL(b->dev), 0);  // generate interrupt
+  outb(base+2, sector_per_block);  // number of sectors
+  outb(base+3, sector & 0xff);
+  outb(base+4, (sector >> 8) & 0xff);
+  outb(base+5, (sector >> 16) & 0xff);
+  outb(base+6, 0xe0 | ((b->dev&1)<<4) | ((sector>>24)&0x0f));
   if(b->flags & B_DIRTY){
-    outb(0x1f7, write_cmd);
-    outsl(0x1f0, b->data, BSIZE/4);
+    outb(base+7, write_cmd);
+    outsl(base, b->data, BSIZE/4);
   } else {
-    outb(0x1f7, read_cmd);
+    outb(base+7, read_cmd);
   }
 }
 
-// Interrupt handler.
+// Interrupt handler for channel chan (0 primary, 1 secondary).
 void
-ideintr(void)
+ideintr(int chan)
 {
   struct buf *b;
 
   // First queued buffer is the active request.
   acquire(&idelock);
 
-  if((b = idequeue) == 0){
+  // Bochs generates spurious interrupts on the secondary channel.
+  if((b = idequeue) == 0 || IDECHAN(b->dev) != chan){
     release(&idelock);
     return;
   }
   idequeue = b->qnext;
 
   // Read data if needed.
-  if(!(b->flags & B_DIRTY) && idewait(1) >= 0)
-    insl(0x1f0, b->data, BSIZE/4);
+  if(!(b->flags & B_DIRTY) && idewait(b->dev, 1) >= 0)
+    insl(IDEBASE(b->dev), b->data, BSIZE/4);
 
   // Wake process waiting for this buf.
   b->flags |= B_VALID;
@@ -144,8 +181,8 @@ iderw(struct buf *b)
     panic("iderw: buf not locked");
   if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
     panic("iderw: nothing to do");
-  if(b->dev != 0 && !havedisk1)
-    panic("iderw: ide disk 1 not present");
+  if(!idepresent(b->dev))
+    panic("iderw: ide disk not present");
 
   acquire(&idelock);  //DOC:acquire-lock
 
@@ -1,45 +1,122 @@
 // Physical memory allocator, intended to allocate
 // memory for user processes, kernel stacks, page table pages,
-// and pipe buffers. Allocates 4096-byte pages.
+// and pipe buffers. Allocates 4096-byte pages, or physically
+// contiguous blocks of 2^order pages.
+//
+// The pages are managed by a binary buddy allocator: a free
+// block of order k starts at a page number that is a multiple
+// of 2^k, and when both halves of a block are free they are
+// merged again.  Single pages are served from per-CPU magazines
+// on top of it.
+//
+// Every allocation carries a tag (KM_USER, KM_PIPE, ... in
+// memstat.h) naming the subsystem it is for, kept with the page
+// until it is freed.  Each CPU counts the pages it allocated and
+// freed per tag without locking; only the sum over all CPUs is
+// meaningful, and the memstat system call reports that.
 
 #include "types.h"
 #include "defs.h"
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "proc.h"
 #include "spinlock.h"
+#include "x86.h"
+#include "memstat.h"
 
 void freerange(void *vstart, void *vend);
 extern char end[]; // first address after kernel loaded from ELF file
                    // defined by the kernel linker script in kernel.ld
 
+#define NPHYSPAGE (PHYSTOP/PGSIZE)
+
+// A free block, stored in its own first page.
 struct run {
   struct run *next;
+  struct run *prev;
+};
+
+// What the buddy allocator knows about each physical page.
+// Only meaningful for the first page of a block.
+struct pageinfo {
+  uchar order;                   // Block order
+  uchar free;                    // Block is on freelist[order]
+  uchar tag;                     // KM_ tag of an allocated block
+};
+
+// Each CPU keeps a small magazine of free pages so that the
+// common kalloc/kfree path only takes the magazine's own lock,
+// which no other CPU touches unless memory has run out, not
+// kmem.lock.  Magazines are refilled from and drained to the
+// buddy lists MAGBATCH pages at a time.
+#define MAGBATCH 16
+#define MAGSIZE  (2*MAGBATCH)
+
+struct magazine {
+  struct spinlock lock;
+  struct run *list;
+  int n;
 };
 
 struct {
   struct spinlock lock;
   int use_lock;
-  struct run *freelist;
+  struct run *freelist[MAXORDER+1];
+  uint nblocks[MAXORDER+1];      // blocks on each freelist
+  uint nfree;                    // pages on the freelists
+  uint npages;                   // pages given to the allocator
+  uint lazystart, lazyend;       // free page numbers not yet on a freelist
+  struct pageinfo page[NPHYSPAGE];
+  int ref[NPHYSPAGE];            // Mappings of each allocated page
+  struct magazine mag[NCPU];
+  struct cpumemstat stat[NCPU];
+  int tagpages[NCPU][NKMTAG];    // pages allocated minus freed, per tag
 } kmem;
 
+// Pages zeroed ahead of time by idle CPUs, so that
+// kalloc_zeroed() on the fork/exec/sbrk path is just a pop.
+// Only the link word of a pooled page is non-zero.
+#define ZPOOLSIZE 64
+
+static char *zpoolpop(int, int);
+static char *steal(int);
+
+struct {
+  struct spinlock lock;
+  struct run *list;
+  int n;
+  uint hits;                     // kalloc_zeroed served from the pool
+  uint misses;                   // kalloc_zeroed had to zero a page
+} zpool;
+
 // Initialization happens in two phases.
 // 1. main() calls kinit1() while still using entrypgdir to place just
 // the pages mapped by entrypgdir on free list.
 // 2. main() calls kinit2() with the rest of the physical pages
 // after installing a full page table that maps them on all cores.
+// kinit2 only records the range; buddyalloc() moves it onto the
+// free lists a block at a time, as it runs short.
 void
 kinit1(void *vstart, void *vend)
 {
+  int i;
+
   initlock(&kmem.lock, "kmem");
+  for(i = 0; i < NCPU; i++)
+    initlock(&kmem.mag[i].lock, "kmag");
+  initlock(&zpool.lock, "zpool");
   kmem.use_lock = 0;
   freerange(vstart, vend);
+  kmem.npages = kmem.nfree;
 }
 
 void
 kinit2(void *vstart, void *vend)
 {
-  freerange(vstart, vend);
+  kmem.lazystart = V2P(PGROUNDUP((uint)vstart)) / PGSIZE;
+  kmem.lazyend = V2P(PGROUNDDOWN((uint)vend)) / PGSIZE;
+  kmem.npages += kmem.lazyend - kmem.lazystart;
   kmem.use_lock = 1;
 }
 
@@ -51,46 +128,469 @@ freerange(void *vstart, void *vend)
   for(; p + PGSIZE <= (char*)vend; p += PGSIZE)
     kfree(p);
 }
+
+static void
+pushfree(uint pn, int order)
+{
+  struct run *r = (struct run*)P2V(pn*PGSIZE);
+
+  r->prev = 0;
+  r->next = kmem.freelist[order];
+  if(r->next)
+    r->next->prev = r;
+  kmem.freelist[order] = r;
+  kmem.page[pn].order = order;
+  kmem.page[pn].free = 1;
+  kmem.nblocks[order]++;
+  kmem.nfree += 1 << order;
+}
+
+static void
+unlinkfree(uint pn, int order)
+{
+  struct run *r = (struct run*)P2V(pn*PGSIZE);
+
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.freelist[order] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  kmem.page[pn].free = 0;
+  kmem.nblocks[order]--;
+  kmem.nfree -= 1 << order;
+}
+
+static void buddyfree(char*, int);
+
+// Move the next block of the kinit2 range onto the free lists:
+// the largest one that is aligned to its size.
+// Returns 0 if the range is used up.
+static int
+lazyfree(void)
+{
+  uint pn;
+  int k;
+
+  pn = kmem.lazystart;
+  if(pn >= kmem.lazyend)
+    return 0;
+  for(k = 0; k < MAXORDER; k++)
+    if((pn & (1 << k)) || pn + (2 << k) > kmem.lazyend)
+      break;
+  kmem.lazystart += 1 << k;
+  buddyfree(P2V(pn*PGSIZE), k);
+  return 1;
+}
+
+// Take a block of 2^order pages off the buddy lists, splitting
+// a larger block if needed.  Caller holds kmem.lock.
+static char*
+buddyalloc(int order)
+{
+  uint pn;
+  int k;
+
+  for(;;){
+    for(k = order; k <= MAXORDER && kmem.freelist[k] == 0; k++)
+      ;
+    if(k <= MAXORDER || !lazyfree())
+      break;
+  }
+  if(k > MAXORDER)
+    return 0;
+  pn = V2P(kmem.freelist[k]) / PGSIZE;
+  unlinkfree(pn, k);
+  // Give back the upper halves we don't need.
+  while(k > order){
+    k--;
+    pushfree(pn + (1 << k), k);
+  }
+  kmem.page[pn].order = order;
+  return P2V(pn*PGSIZE);
+}
+
+// Return a block to the buddy lists, merging it with its
+// buddy for as long as the buddy is free and whole.
+// Caller holds kmem.lock.
+static void
+buddyfree(char *v, int order)
+{
+  uint pn, bn;
+
+  pn = V2P(v) / PGSIZE;
+  while(order < MAXORDER){
+    bn = pn ^ (1 << order);
+    if(bn >= NPHYSPAGE || !kmem.page[bn].free || kmem.page[bn].order != order)
+      break;
+    unlinkfree(bn, order);
+    pn &= ~(1 << order);
+    order++;
+  }
+  pushfree(pn, order);
+}
+
+// Tag the block of 2^order pages at v and count it for this
+// CPU.  Caller has interrupts off or is still single-threaded.
+static void
+tagalloc(char *v, int order, int tag)
+{
+  kmem.page[V2P(v) / PGSIZE].tag = tag;
+  kmem.tagpages[kmem.use_lock ? cpuid() : 0][tag] += 1 << order;
+}
+
+// Count the block of 2^order pages at v as freed.
+static void
+tagfree(char *v, int order)
+{
+  int tag;
+
+  tag = kmem.page[V2P(v) / PGSIZE].tag;
+  kmem.tagpages[kmem.use_lock ? cpuid() : 0][tag] -= 1 << order;
+}
+
+// Take kmem.lock, noting whether another CPU held it.
+static void
+lockkmem(struct cpumemstat *st)
+{
+  if(kmem.lock.locked)
+    st->contended++;
+  acquire(&kmem.lock);
+}
+
+// Move up to MAGBATCH pages from the buddy lists to m.
+// Caller holds m->lock.
+static void
+refill(struct magazine *m, struct cpumemstat *st)
+{
+  struct run *r;
+  int i;
+
+  lockkmem(st);
+  for(i = 0; i < MAGBATCH && (r = (struct run*)buddyalloc(0)) != 0; i++){
+    r->next = m->list;
+    m->list = r;
+    m->n++;
+  }
+  release(&kmem.lock);
+  st->refills++;
+}
+
+// Move MAGBATCH pages from m back to the buddy lists.
+// Caller holds m->lock.
+static void
+drain(struct magazine *m, struct cpumemstat *st)
+{
+  struct run *r;
+  int i;
+
+  lockkmem(st);
+  for(i = 0; i < MAGBATCH && (r = m->list) != 0; i++){
+    m->list = r->next;
+    m->n--;
+    buddyfree((char*)r, 0);
+  }
+  release(&kmem.lock);
+  st->drains++;
+}
+
 //PAGEBREAK: 21
 // Free the page of physical memory pointed at by v,
 // which normally should have been returned by a
 // call to kalloc().  (The exception is when
 // initializing the allocator; see kinit above.)
+// If the page has been shared with kref(), this only drops
+// one reference.
 void
 kfree(char *v)
 {
   struct run *r;
+  struct magazine *m;
+  struct cpumemstat *st;
+  uint pn;
+  int ref;
 
   if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
     panic("kfree");
 
+  pn = V2P(v) / PGSIZE;
+  if((ref = fetch_and_add(&kmem.ref[pn], -1)) > 1)
+    return;
+  kmem.ref[pn] = 0;
+
+#ifdef DEBUG_KALLOC
   // Fill with junk to catch dangling refs.
   memset(v, 1, PGSIZE);
+#endif
+
+  if(!kmem.use_lock){
+    // kinit1() hands over pages that were never allocated.
+    if(ref == 1)
+      tagfree(v, 0);
+    buddyfree(v, 0);
+    return;
+  }
 
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
   r = (struct run*)v;
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  if(kmem.use_lock)
-    release(&kmem.lock);
+  pushcli();
+  m = &kmem.mag[cpuid()];
+  st = &kmem.stat[cpuid()];
+  st->frees++;
+  tagfree(v, 0);
+  acquire(&m->lock);
+  r->next = m->list;
+  m->list = r;
+  m->n++;
+  if(m->n > MAGSIZE)
+    drain(m, st);
+  release(&m->lock);
+  popcli();
 }
 
-// Allocate one 4096-byte page of physical memory.
+// Allocate one 4096-byte page of physical memory for the
+// subsystem tag names.
 // Returns a pointer that the kernel can use.
 // Returns 0 if the memory cannot be allocated.
 char*
-kalloc(void)
+kalloc(int tag)
 {
   struct run *r;
+  struct magazine *m;
+  struct cpumemstat *st;
+
+  if(!kmem.use_lock){
+    if((r = (struct run*)buddyalloc(0)) != 0){
+      kmem.ref[V2P(r) / PGSIZE] = 1;
+      tagalloc((char*)r, 0, tag);
+    }
+    return (char*)r;
+  }
+
+  pushcli();
+  m = &kmem.mag[cpuid()];
+  st = &kmem.stat[cpuid()];
+  st->allocs++;
+  acquire(&m->lock);
+  if(m->list)
+    st->hits++;
+  else
+    refill(m, st);
+  if((r = m->list) != 0){
+    m->list = r->next;
+    m->n--;
+    kmem.ref[V2P(r) / PGSIZE] = 1;
+    tagalloc((char*)r, 0, tag);
+  }
+  release(&m->lock);
+  popcli();
+  // Out of free pages here: the other CPUs' magazines, and
+  // then the zero pool, are the last reserve.
+  if(r == 0)
+    r = (struct run*)steal(tag);
+  if(r == 0)
+    r = (struct run*)zpoolpop(tag, 0);
+  return (char*)r;
+}
+
+// This CPU's magazine and the buddy lists are empty, but other
+// CPUs' magazines may not be, and only their owners allocate
+// from them.  Drain them all to the buddy lists and take a page
+// from there for tag, or return 0 if there is none.
+static char*
+steal(int tag)
+{
+  struct magazine *m;
+  struct cpumemstat *st;
+  char *v;
+
+  pushcli();
+  st = &kmem.stat[cpuid()];
+  for(m = kmem.mag; m < &kmem.mag[ncpu]; m++){
+    acquire(&m->lock);
+    while(m->n > 0)
+      drain(m, st);
+    release(&m->lock);
+  }
+  lockkmem(st);
+  if((v = buddyalloc(0)) != 0){
+    kmem.ref[V2P(v) / PGSIZE] = 1;
+    tagalloc(v, 0, tag);
+  }
+  release(&kmem.lock);
+  popcli();
+  return v;
+}
+
+// Take a page from the zero pool for tag, or return 0 if it
+// is empty.  count says to count a kalloc_zeroed hit or miss.
+static char*
+zpoolpop(int tag, int count)
+{
+  struct run *r;
+
+  acquire(&zpool.lock);
+  if((r = zpool.list) != 0){
+    zpool.list = r->next;
+    zpool.n--;
+  }
+  if(count && r)
+    zpool.hits++;
+  else if(count)
+    zpool.misses++;
+  release(&zpool.lock);
+  if(r){
+    r->next = 0;
+    pushcli();
+    tagfree((char*)r, 0);
+    tagalloc((char*)r, 0, tag);
+    popcli();
+  }
+  return (char*)r;
+}
+
+// Allocate one page of zeroed physical memory for tag.
+char*
+kalloc_zeroed(int tag)
+{
+  char *v;
+
+  if(kmem.use_lock && (v = zpoolpop(tag, 1)) != 0)
+    return v;
+  if((v = kalloc(tag)) != 0)
+    memset(v, 0, PGSIZE);
+  return v;
+}
+
+// Called from the scheduler when this CPU has nothing to run:
+// zero one page for the pool, if it is not full yet.
+void
+kzeroidle(void)
+{
+  char *v;
+
+  if(zpool.n >= ZPOOLSIZE || (v = kalloc(KM_ZPOOL)) == 0)
+    return;
+  memset(v, 0, PGSIZE);
+  acquire(&zpool.lock);
+  if(zpool.n < ZPOOLSIZE){
+    ((struct run*)v)->next = zpool.list;
+    zpool.list = (struct run*)v;
+    zpool.n++;
+    v = 0;
+  }
+  release(&zpool.lock);
+  if(v)
+    kfree(v);
+}
+
+// Add a reference to the kalloc'ed page v, which is about to
+// be mapped once more.  kfree drops one reference.
+void
+kref(char *v)
+{
+  if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
+    panic("kref");
+  fetch_and_add(&kmem.ref[V2P(v) / PGSIZE], 1);
+}
+
+// Number of references to page v.
+int
+krefcount(char *v)
+{
+  return kmem.ref[V2P(v) / PGSIZE];
+}
+
+// Free pages right now, without locking; for kswapd, which
+// only needs an estimate.
+uint
+kfreecount(void)
+{
+  uint n;
+  int i;
+
+  n = kmem.nfree + (kmem.lazyend - kmem.lazystart);
+  for(i = 0; i < ncpu; i++)
+    n += kmem.mag[i].n;
+  return n;
+}
 
+// Allocate 2^order physically contiguous pages, aligned to
+// their size, for tag.  Returns 0 if no block that large is free.
+char*
+kalloc_pages(int order, int tag)
+{
+  char *v;
+
+  if(order < 0 || order > MAXORDER)
+    return 0;
   if(kmem.use_lock)
     acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
+  if((v = buddyalloc(order)) != 0)
+    tagalloc(v, order, tag);
+  if(kmem.use_lock)
+    release(&kmem.lock);
+  return v;
+}
+
+// Free a block returned by kalloc_pages(order).
+void
+kfree_pages(char *v, int order)
+{
+  if(order < 0 || order > MAXORDER ||
+     (uint)v % (PGSIZE << order) || v < end || V2P(v) >= PHYSTOP)
+    panic("kfree_pages");
+
+#ifdef DEBUG_KALLOC
+  memset(v, 1, PGSIZE << order);
+#endif
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  tagfree(v, order);
+  buddyfree(v, order);
   if(kmem.use_lock)
     release(&kmem.lock);
-  return (char*)r;
 }
 
+// Turn the block of 2^order pages at v, from kalloc_pages(),
+// into 2^order single pages that kfree() can free one by one.
+void
+ksplit(char *v, int order)
+{
+  uint pn, i;
+
+  pn = V2P(v) / PGSIZE;
+  for(i = 0; i < (1 << order); i++){
+    kmem.page[pn+i].order = 0;
+    kmem.page[pn+i].tag = kmem.page[pn].tag;
+    kmem.ref[pn+i] = 1;
+  }
+}
+
+// Fill in allocator statistics for the memstat system call.
+// Magazines are read without stopping their CPUs, so the
+// numbers are only a snapshot.
+void
+kmemstat(struct memstat *ms)
+{
+  int i, t;
+
+  memset(ms, 0, sizeof(*ms));
+  ms->ncpu = ncpu;
+  ms->kernpages = (V2P(end) + PGSIZE-1) / PGSIZE;
+  acquire(&kmem.lock);
+  ms->totalpages = kmem.npages;
+  ms->freepages = kmem.nfree + (kmem.lazyend - kmem.lazystart);
+  ms->zpool = zpool.n;
+  ms->zhits = zpool.hits;
+  ms->zmisses = zpool.misses;
+  for(i = 0; i <= MAXORDER; i++)
+    ms->nblocks[i] = kmem.nblocks[i];
+  release(&kmem.lock);
+  for(i = 0; i < ncpu && i < NCPU; i++){
+    ms->cpu[i] = kmem.stat[i];
+    ms->cpu[i].cached = kmem.mag[i].n;
+    ms->freepages += kmem.mag[i].n;
+    for(t = 0; t < NKMTAG; t++)
+      ms->tagpages[t] += kmem.tagpages[i][t];
+  }
+}
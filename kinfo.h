@@ -0,0 +1,25 @@
+// Kernel info pages, mapped read-only into every address space
+// so that user code can read a few hot values without a trap.
+// Include types.h first.
+
+#define KINFO   0xFD000000   // struct kinfo, shared by all processes
+#define KPINFO  0xFD001000   // struct kpinfo, private to each process
+
+#define KCALSHIFT 4          // calibrate the TSC over 1<<KCALSHIFT ticks
+
+// Offset of kinfo.sysenter, for usys.S.
+#define KI_SYSENTER 16
+
+#ifndef __ASSEMBLER__
+struct kinfo {
+  volatile uint ticks;       // Same as the kernel's ticks
+  volatile uint tickcycles;  // TSC cycles per tick, 0 until calibrated
+  volatile uint64 ticktsc;   // TSC value at the last tick
+  uint sysenter;             // Non-zero if system calls may use sysenter
+};
+
+struct kpinfo {
+  int pid;                   // Process ID
+  volatile int cpu;          // CPU the process was last dispatched on
+};
+#endif
@@ -0,0 +1,120 @@
+// Kernel stacks.
+//
+// Kernel stacks live in their own region of kernel virtual
+// memory, KSTACKBASE up, in slots of one unmapped guard page
+// followed by KSTACKSIZE of stack.  A stack that overflows runs
+// into its guard page, and the fault that follows cannot be
+// delivered on that stack either; the double fault task (see
+// trap.c) reports it instead of memory getting silently
+// corrupted.  The region has one page table, which every page
+// directory shares (see setupkvm), so mapping a stack once maps
+// it everywhere.
+//
+// Stacks are never unmapped, which would mean flushing every
+// CPU's TLB.  A freed stack goes to a small cache on the CPU that
+// freed it, or else back to a global list, and the next fork
+// takes it from there without touching kalloc or the page table.
+// Slots that were never used are mapped on demand.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+
+#define KSCACHE   4                          // free stacks cached per CPU
+#define KSSLOT    (PGSIZE + KSTACKSIZE)      // guard page plus stack
+#define NKSTACK   (NPROC + NCPU*KSCACHE)     // caches cannot starve a fork
+
+struct kscache {
+  char *stack[KSCACHE];
+  int n;
+};
+
+struct {
+  struct spinlock lock;
+  char *free[NKSTACK];   // mapped stacks not in use
+  int nfree;
+  int next;              // first slot never used
+  struct kscache cache[NCPU];
+} kstacks;
+
+void
+kstackinit(void)
+{
+  initlock(&kstacks.lock, "kstacks");
+  if(NKSTACK*KSSLOT > SUPERPGSIZE)
+    panic("kstackinit: more stacks than one page table maps");
+}
+
+// Map the pages of a fresh slot.  Caller holds kstacks.lock.
+static char*
+kstackslot(void)
+{
+  char *s;
+  int i;
+
+  if(kstacks.next == NKSTACK)
+    return 0;
+  s = (char*)(KSTACKBASE + kstacks.next*KSSLOT + PGSIZE);
+  for(i = 0; i < KSTACKSIZE; i += PGSIZE)
+    if(kstackmap((uint)s + i) < 0)
+      return 0;
+  kstacks.next++;
+  return s;
+}
+
+// Return a kernel stack, or 0 if there is none.
+char*
+kstackalloc(void)
+{
+  struct kscache *c;
+  char *s;
+
+  s = 0;
+  pushcli();
+  c = &kstacks.cache[cpuid()];
+  if(c->n > 0)
+    s = c->stack[--c->n];
+  popcli();
+  if(s)
+    return s;
+
+  acquire(&kstacks.lock);
+  if(kstacks.nfree > 0)
+    s = kstacks.free[--kstacks.nfree];
+  else
+    s = kstackslot();
+  release(&kstacks.lock);
+  return s;
+}
+
+void
+kstackfree(char *s)
+{
+  struct kscache *c;
+
+  pushcli();
+  c = &kstacks.cache[cpuid()];
+  if(c->n < KSCACHE){
+    c->stack[c->n++] = s;
+    s = 0;
+  }
+  popcli();
+  if(s == 0)
+    return;
+
+  acquire(&kstacks.lock);
+  kstacks.free[kstacks.nfree++] = s;
+  release(&kstacks.lock);
+}
+
+// Is va in the guard page of a kernel stack?
+int
+kstackguard(uint va)
+{
+  return va >= KSTACKBASE && va < KSTACKBASE + NKSTACK*KSSLOT &&
+         (va - KSTACKBASE) % KSSLOT < PGSIZE;
+}
@@ -5,6 +5,7 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "memstat.h"
 #include "x86.h"
 
 static void startothers(void);
@@ -12,29 +13,63 @@ static void mpmain(void)  __attribute__((noreturn));
 extern pde_t *kpgdir;
 extern char end[]; // first address after kernel loaded from ELF file
 
+// Boot stage timings, printed once the console works.
+#define NSTAGE 24
+static uint64 stagetsc[NSTAGE+1];
+static char *stagename[NSTAGE];
+static int nstage;
+
+// Run one boot stage and note the TSC when it is done.
+#define STAGE(call) do { \
+  call; \
+  if(nstage < NSTAGE){ \
+    stagename[nstage] = #call; \
+    stagetsc[++nstage] = rdtsc(); \
+  } \
+} while(0)
+
+static void
+bootreport(void)
+{
+  int i;
+
+  cprintf("boot stages (kcycles):\n");
+  for(i = 0; i < nstage; i++)
+    cprintf("  %d\t%s\n", (uint)((stagetsc[i+1] - stagetsc[i]) >> 10), stagename[i]);
+  cprintf("  %d\ttotal\n", (uint)((stagetsc[nstage] - stagetsc[0]) >> 10));
+}
+
 // Bootstrap processor starts running C code here.
 // Allocate a real stack and switch to it, first
 // doing some setup required for memory allocator to work.
 int
 main(void)
 {
-  kinit1(end, P2V(4*1024*1024)); // phys page allocator
-  kvmalloc();      // kernel page table
-  mpinit();        // detect other processors
-  lapicinit();     // interrupt controller
-  seginit();       // segment descriptors
-  picinit();       // disable pic
-  ioapicinit();    // another interrupt controller
-  consoleinit();   // console hardware
-  uartinit();      // serial port
-  pinit();         // process table
-  tvinit();        // trap vectors
-  binit();         // buffer cache
-  fileinit();      // file table
-  ideinit();       // disk 
-  startothers();   // start other processors
-  kinit2(P2V(4*1024*1024), P2V(PHYSTOP)); // must come after startothers()
-  userinit();      // first user process
+  stagetsc[0] = rdtsc();
+  STAGE(kinit1(end, P2V(4*1024*1024))); // phys page allocator
+  STAGE(kvmalloc());      // kernel page table
+  STAGE(kstackinit());    // kernel stack pool
+  STAGE(mpinit());        // detect other processors
+  STAGE(lapicinit());     // interrupt controller
+  STAGE(seginit());       // segment descriptors
+  STAGE(picinit());       // disable pic
+  STAGE(ioapicinit());    // another interrupt controller
+  STAGE(consoleinit());   // console hardware
+  STAGE(traceinit());     // syscall trace device
+  STAGE(uartinit());      // serial port
+  STAGE(pinit());         // process table
+  STAGE(tvinit());        // trap vectors
+  STAGE(binit());         // buffer cache
+  STAGE(pcinit());        // mmap page cache
+  STAGE(fileinit());      // file table
+  STAGE(shminit());       // shared memory segments
+  STAGE(ideinit());       // disk 
+  STAGE(startothers());   // start other processors
+  STAGE(kinit2(P2V(4*1024*1024), P2V(PHYSTOP))); // must come after startothers()
+  STAGE(oominit());       // memory limits
+  STAGE(userinit());      // first user process
+  STAGE(swapinit());      // swap disk and kswapd
+  bootreport();
   mpmain();        // finish this processor's setup
 }
 
@@ -83,7 +118,7 @@ startothers(void)
     // Tell entryother.S what stack to use, where to enter, and what
     // pgdir to use. We cannot use kpgdir yet, because the AP processor
     // is running in low  memory, so we use entrypgdir for the APs too.
-    stack = kalloc();
+    stack = kalloc(KM_KSTACK);
     *(void**)(code-4) = stack + KSTACKSIZE;
     *(void(**)(void))(code-8) = mpenter;
     *(int**)(code-12) = (void *) V2P(entrypgdir);
@@ -27,11 +27,18 @@ ideinit(void)
 
 // Interrupt handler.
 void
-ideintr(void)
+ideintr(int chan)
 {
   // no-op
 }
 
+// Only the file system disk exists.
+int
+idepresent(int dev)
+{
+  return dev == 1;
+}
+
 // Sync buf with disk.
 // If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
 // Else if B_VALID is not set, read buf from disk, set B_VALID.
@@ -0,0 +1,111 @@
+// memlimittest: check memory limits on processes and groups.
+// Usage: memlimittest
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define PG 4096
+
+void
+fail(char *msg)
+{
+  printf(1, "memlimittest: FAIL %s\n", msg);
+  exit();
+}
+
+// Pages of address space this process is charged for.
+uint
+mypages(void)
+{
+  return ((uint)sbrk(0) + PG - 1) / PG;
+}
+
+void
+proclimit(void)
+{
+  uint n;
+
+  n = mypages();
+  if(memlimit(n - 1, 0) == 0)
+    fail("limit below current size");
+  if(memlimit(n + 10, 0) < 0)
+    fail("memlimit");
+  if(sbrk(5*PG) == (char*)-1)
+    fail("sbrk under the limit");
+  if(sbrk(20*PG) != (char*)-1)
+    fail("sbrk over the limit");
+  if(sbrk(-5*PG) == (char*)-1 || sbrk(10*PG) == (char*)-1)
+    fail("sbrk after shrinking");
+  if(sbrk(PG) != (char*)-1)
+    fail("sbrk one page over the limit");
+}
+
+// A group with room for three processes this size and 20 pages
+// more: the first child can take 15, the second then cannot.
+void
+grouplimit(void)
+{
+  int held[2], release[2];
+  uint n;
+  char c;
+
+  n = mypages();
+  if(memlimit(3*n + 20, 1) < 0)
+    fail("new group");
+  if(pipe(held) < 0 || pipe(release) < 0)
+    fail("pipe");
+
+  if(fork() == 0){
+    if(sbrk(15*PG) == (char*)-1)
+      fail("first child sbrk");
+    write(held[1], "x", 1);
+    read(release[0], &c, 1);
+    exit();
+  }
+  if(read(held[0], &c, 1) != 1)
+    fail("first child went away");
+
+  if(fork() == 0){
+    if(sbrk(15*PG) != (char*)-1)
+      fail("second child sbrk over the group limit");
+    exit();
+  }
+  wait();
+  write(release[1], "x", 1);
+  while(wait() >= 0)
+    ;
+}
+
+void
+shmlimit(void)
+{
+  if(memlimit(mypages() + 2, 1) < 0)
+    fail("new group");
+  if(shm_open(4901, 4, 0) != -4)
+    fail("shm_open over the group limit");
+  if(shm_open(4902, 1, 0) != 0)
+    fail("shm_open under the group limit");
+  shm_close(4902);
+}
+
+// Run f in a child, so each test starts fresh.
+void
+run(void (*f)(void))
+{
+  if(fork() == 0){
+    f();
+    exit();
+  }
+  wait();
+}
+
+int
+main(void)
+{
+  run(proclimit);
+  run(grouplimit);
+  run(shmlimit);
+  printf(1, "memlimittest: done\n");
+  exit();
+}
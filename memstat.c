@@ -0,0 +1,62 @@
+// memstat: print physical memory statistics: what the
+// allocator has free, which subsystems hold the rest, and how
+// much each process maps.
+
+#include "types.h"
+#include "param.h"
+#include "stat.h"
+#include "user.h"
+#include "memstat.h"
+
+struct memstat ms;
+
+char *tagname[NKMTAG] = {
+[KM_USER]    "user",
+[KM_PGTBL]   "pgtbl",
+[KM_KSTACK]  "kstack",
+[KM_KINFO]   "kinfo",
+[KM_PIPE]    "pipe",
+[KM_SHM]     "shm",
+[KM_PCACHE]  "pcache",
+[KM_ZPOOL]   "zpool",
+};
+
+int
+main(int argc, char *argv[])
+{
+  struct cpumemstat *c;
+  struct procmemstat *p;
+  int i;
+
+  if(memstat(&ms) < 0){
+    printf(2, "memstat: failed\n");
+    exit();
+  }
+  printf(1, "pages: %d total, %d free, kernel image %d\n",
+         ms.totalpages, ms.freepages, ms.kernpages);
+  printf(1, "in use by:");
+  for(i = 0; i < NKMTAG; i++)
+    printf(1, " %s %d", tagname[i], ms.tagpages[i]);
+  printf(1, "\n");
+  printf(1, "zero pool: %d pages, %d hits, %d misses\n",
+         ms.zpool, ms.zhits, ms.zmisses);
+  printf(1, "page cache: %d pages, %d hits, %d misses\n",
+         ms.pcpages, ms.pchits, ms.pcmisses);
+  printf(1, "free blocks by order:");
+  for(i = 0; i <= MAXORDER; i++)
+    printf(1, " %d", ms.nblocks[i]);
+  printf(1, "\n");
+  printf(1, "CPU\tALLOCS\tFREES\tHITS\tREFILLS\tDRAINS\tCONTEND\tCACHED\n");
+  for(i = 0; i < ms.ncpu; i++){
+    c = &ms.cpu[i];
+    printf(1, "%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n", i, c->allocs, c->frees,
+           c->hits, c->refills, c->drains, c->contended, c->cached);
+  }
+  printf(1, "PID\tRSS\tSWAP\tPGTBL\tCHARGED\tLIMIT\tNAME\n");
+  for(i = 0; i < ms.nproc; i++){
+    p = &ms.proc[i];
+    printf(1, "%d\t%d\t%d\t%d\t%d\t%d\t%s\n", p->pid, p->rss, p->swap,
+           p->pgtbl, p->charged, p->limit, p->name);
+  }
+  exit();
+}
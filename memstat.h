@@ -0,0 +1,59 @@
+// Physical page allocator statistics, filled in by the
+// memstat system call.  Include param.h first.
+
+// Allocation tags: what each kalloc'ed page is for.
+#define KM_USER    0   // user memory
+#define KM_PGTBL   1   // page directories and page tables
+#define KM_KSTACK  2   // kernel stacks
+#define KM_KINFO   3   // kernel info pages mapped into user space
+#define KM_PIPE    4   // pipe buffers
+#define KM_SHM     5   // shared memory segments
+#define KM_PCACHE  6   // page cache
+#define KM_ZPOOL   7   // pre-zeroed pages not handed out yet
+#define NKMTAG     8
+
+struct cpumemstat {
+  uint allocs;      // kalloc calls
+  uint frees;       // kfree calls
+  uint hits;        // kalloc served from the magazine alone
+  uint refills;     // batches taken from the global list
+  uint drains;      // batches returned to the global list
+  uint contended;   // kmem.lock found held by another CPU
+  uint cached;      // pages in the magazine now
+};
+
+// Memory use of one process.
+struct procmemstat {
+  int pid;
+  char name[16];
+  uint rss;         // user pages mapped, shared ones included
+  uint swap;        // user pages in swap
+  uint pgtbl;       // page directory and page table pages
+  uint charged;     // pages of address space charged against limits
+  uint limit;       // its own limit on those, or 0 (see memlimit)
+};
+
+struct memstat {
+  uint totalpages;  // pages the allocator manages
+  uint kernpages;   // pages up to the end of the kernel image
+  uint freepages;   // free pages, global list plus magazines
+  int tagpages[NKMTAG];  // allocated pages by tag
+  uint nblocks[MAXORDER+1]; // free buddy blocks of each order
+  uint zpool;       // pre-zeroed pages ready for kalloc_zeroed
+  uint zhits;       // kalloc_zeroed served from the zero pool
+  uint zmisses;     // kalloc_zeroed that had to zero a page itself
+  uint pcpages;     // file pages in the page cache
+  uint pchits;      // page cache lookups that found the page
+  uint pcmisses;    // page cache lookups that read the file
+  uint swaptotal;   // swap slots (pages); 0 if there is no swap disk
+  uint swapused;    // swap slots in use
+  uint pageins;     // pages read back from swap
+  uint pageouts;    // pages written to swap
+  uint scans;       // pages the clock hand passed
+  uint refs;        // second chances the clock hand gave
+  uint swapwaits;   // page faults that waited for memory
+  uint ncpu;        // valid entries in cpu[]
+  struct cpumemstat cpu[NCPU];
+  uint nproc;       // valid entries in proc[]
+  struct procmemstat proc[NPROC];
+};
@@ -0,0 +1,290 @@
+// Memory-mapped files.
+// mmap() only records a vma in the process; pagefault() brings
+// the pages in from the page cache (pcache.c) on first touch,
+// a few at a time.  Read-only mappings map the cached page
+// itself, so every process mapping the same file page shares
+// it.  Writable mappings are private: they map the cached page
+// copy-on-write, and writes never reach the file.
+//
+// mmap() places mappings above the heap, from KERNBASE down so
+// that sbrk keeps as much room as possible.  exec() maps the
+// program's segments the same way, below sz.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "stat.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "memstat.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "fcntl.h"
+
+// Return a vma of p overlapping [start, end), or 0.
+struct vma*
+vmaoverlap(struct proc *p, uint start, uint end)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->ip && v->start < end && start < v->end)
+      return v;
+  return 0;
+}
+
+// Pick a free range of len bytes between the heap and KERNBASE,
+// highest first and aligned to align, a power of two no smaller
+// than a page, for a file mapping or a shared memory segment.
+// Returns 0 if there is none.
+uint
+vmaspace(struct proc *p, uint len, uint align)
+{
+  struct vma *v;
+  uint a, lo;
+
+  lo = PGROUNDUP(p->sz);
+  if(len > KERNBASE - lo)
+    return 0;
+  for(a = (KERNBASE - len) & ~(align-1); a >= lo; ){
+    if((v = vmaoverlap(p, a, a + len)) != 0){
+      if(v->start < lo + len)
+        break;
+      a = (v->start - len) & ~(align-1);
+    } else if(uvmmapped(p->pgdir, a, a + len)){
+      // A shared memory segment.
+      if(a < lo + align)
+        break;
+      a -= align;
+    } else
+      return a;
+  }
+  return 0;
+}
+
+// Map len bytes of f starting at offset off into the current
+// process.  Returns the address of the mapping, or -1.
+int
+mmap(struct file *f, uint off, uint len, int prot)
+{
+  struct proc *p = myproc();
+  struct vma *v, *nv;
+  uint a;
+
+  if(f->type != FD_INODE || !f->readable || f->ip->type != T_FILE)
+    return -1;
+  if(len == 0 || off % PGSIZE != 0 || !(prot & PROT_READ))
+    return -1;
+  len = PGROUNDUP(len);
+  if(len == 0 || off + len < off)
+    return -1;
+
+  nv = 0;
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->ip == 0){
+      nv = v;
+      break;
+    }
+  if(nv == 0 || (a = vmaspace(p, len, PGSIZE)) == 0)
+    return -1;
+  // Written pages become private copies: charge for them now.
+  if((prot & PROT_WRITE) && memresize(p, 0, len) < 0)
+    return -1;
+
+  nv->start = a;
+  nv->end = a + len;
+  nv->fileend = nv->end;
+  nv->off = off;
+  nv->prot = prot;
+  nv->ip = idup(f->ip);
+  return a;
+}
+
+// Unmap [addr, addr+len), which must lie within one mapping.
+// Unmapping the middle of a mapping splits it in two.
+int
+munmap(uint addr, uint len)
+{
+  struct proc *p = myproc();
+  struct vma *v, *nv;
+  struct inode *ip;
+  uint end;
+
+  end = PGROUNDUP(addr + len);
+  if(addr % PGSIZE != 0 || len == 0 || end <= addr)
+    return -1;
+  if((v = vmaoverlap(p, addr, end)) == 0 || addr < v->start || end > v->end)
+    return -1;
+  nv = 0;
+  if(addr != v->start && end != v->end){
+    for(nv = p->vma; nv < &p->vma[NVMA]; nv++)
+      if(nv->ip == 0)
+        break;
+    if(nv == &p->vma[NVMA])
+      return -1;
+  }
+  if((v->prot & PROT_WRITE) && v->start >= p->sz)
+    memresize(p, end - addr, 0);
+
+  ip = 0;
+  if(addr == v->start && end == v->end){
+    ip = v->ip;
+    v->ip = 0;
+  } else if(addr == v->start){
+    v->off += end - v->start;
+    v->start = end;
+  } else if(end == v->end){
+    v->end = addr;
+  } else {
+    *nv = *v;
+    nv->start = end;
+    nv->off = v->off + (end - v->start);
+    idup(nv->ip);
+    v->end = addr;
+  }
+
+  deallocuvm(p->pgdir, end, addr);
+  lcr3(V2P(p->pgdir));
+  if(ip){
+    begin_op();
+    iput(ip);
+    end_op();
+  }
+  return 0;
+}
+
+// Map the page of v at a from the page cache.  The page where
+// the file data ends gets a private copy with the rest zeroed.
+// Caller holds v->ip's lock.  Returns FAULT_NOMEM if memory
+// is short.
+static int
+vmamap(pde_t *pgdir, struct vma *v, uint a)
+{
+  char *page, *mem;
+  int perm;
+
+  if((page = pcget(v->ip, v->off + (a - v->start))) == 0)
+    return FAULT_NOMEM;
+  perm = PTE_U;
+  if(v->prot & PROT_WRITE)
+    perm |= PTE_COW;
+  if(v->fileend < a + PGSIZE){
+    if((mem = kalloc_zeroed(KM_USER)) == 0){
+      kfree(page);
+      return FAULT_NOMEM;
+    }
+    memmove(mem, page, v->fileend - a);
+    kfree(page);
+    page = mem;
+    perm = PTE_U;
+    if(v->prot & PROT_WRITE)
+      perm |= PTE_W;
+  }
+  if(mapupage(pgdir, a, page, perm) < 0){
+    kfree(page);
+    return FAULT_NOMEM;
+  }
+  return 0;
+}
+
+// Resolve a fault at va, if va lies in a mapping: map the page,
+// and read ahead the next few that are not in yet.  A write to
+// a page that is in already is a copy-on-write fault.
+// Returns -1 otherwise, or FAULT_NOMEM if memory is short.
+int
+vmafault(struct proc *p, uint va, uint err)
+{
+  struct vma *v;
+  uint a, n;
+  int r;
+
+  if((v = vmaoverlap(p, va, va + 1)) == 0)
+    return -1;
+  if((err & FEC_WR) && !(v->prot & PROT_WRITE))
+    return -1;
+  if(err & FEC_PR)
+    return cowfault(p->pgdir, va);
+  // Reading the file sleeps, which the kernel may not do with a
+  // spinlock held; system calls prefault their buffers instead.
+  if(!(readeflags() & FL_IF) && mycpu()->ncli > 0)
+    return -1;
+
+  // A write to the fresh page faults once more if it is
+  // copy-on-write, and cowfault() copies it then.
+  a = PGROUNDDOWN(va);
+  ilock(v->ip);
+  r = vmamap(p->pgdir, v, a);
+  for(n = 1; r == 0 && n < NREADAHEAD; n++){
+    a += PGSIZE;
+    if(a >= v->end || uvmmapped(p->pgdir, a, a + PGSIZE))
+      break;
+    if(vmamap(p->pgdir, v, a) < 0)
+      break;
+  }
+  iunlock(v->ip);
+  return r;
+}
+
+// Bytes of p's writable file mappings, for which oom.c charges
+// p as for its heap.
+uint
+vmacommit(struct proc *p)
+{
+  struct vma *v;
+  uint n;
+
+  n = 0;
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->ip && v->start >= p->sz && (v->prot & PROT_WRITE))
+      n += v->end - v->start;
+  return n;
+}
+
+// Give child np the mappings of p, sharing the pages that are
+// already in.  Private pages become copy-on-write in both.
+// Program segments lie below sz, where copyuvm() did this.
+int
+vmafork(struct proc *p, struct proc *np)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->ip && v->start >= p->sz &&
+       copyuvmrange(p->pgdir, np->pgdir, v->start, v->end) < 0)
+      return -1;
+  lcr3(V2P(p->pgdir));
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    np->vma[v - p->vma] = *v;
+    if(v->ip)
+      idup(v->ip);
+  }
+  return 0;
+}
+
+// Drop the NVMA mappings in vma, for exit and exec.  The pages
+// themselves go with the page table.
+void
+vmaclose(struct vma *vma)
+{
+  struct vma *v;
+  int n;
+
+  n = 0;
+  for(v = vma; v < &vma[NVMA]; v++)
+    if(v->ip)
+      n++;
+  if(n == 0)
+    return;
+  begin_op();
+  for(v = vma; v < &vma[NVMA]; v++){
+    if(v->ip){
+      iput(v->ip);
+      v->ip = 0;
+    }
+  }
+  end_op();
+}
@@ -0,0 +1,171 @@
+// mmaptest: check mmap/munmap and compare scanning a file
+// through a mapping with scanning it through read().
+// Usage: mmaptest [file]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "x86.h"
+
+char buf[4096];
+
+void
+fail(char *msg)
+{
+  printf(1, "mmaptest: FAIL %s\n", msg);
+  exit();
+}
+
+// Run f in a child and check that it gets killed.
+void
+mustfault(char *what, void (*f)(char*), char *a)
+{
+  int pid;
+
+  if((pid = fork()) == 0){
+    f(a);
+    printf(1, "mmaptest: FAIL %s did not fault\n", what);
+    exit();
+  }
+  wait();
+}
+
+void
+readbyte(char *a)
+{
+  volatile char c = a[0];
+  (void)c;
+}
+
+void
+writebyte(char *a)
+{
+  a[0] = 'x';
+}
+
+uint
+sumread(int fd)
+{
+  uint sum;
+  int i, n;
+
+  sum = 0;
+  while((n = read(fd, buf, sizeof(buf))) > 0)
+    for(i = 0; i < n; i++)
+      sum += (uchar)buf[i];
+  return sum;
+}
+
+uint
+summap(char *a, int n)
+{
+  uint sum;
+  int i;
+
+  sum = 0;
+  for(i = 0; i < n; i++)
+    sum += (uchar)a[i];
+  return sum;
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *file, *a, *w;
+  struct stat st;
+  int fd, size, i, n, pfd[2];
+  uint s1, s2, t1, t2;
+  uint64 t0;
+
+  file = argc > 1 ? argv[1] : "README";
+  if((fd = open(file, O_RDONLY)) < 0 || fstat(fd, &st) < 0)
+    fail("open");
+  size = st.size;
+
+  if(mmap(fd, 1, size, PROT_READ) != (void*)-1)
+    fail("unaligned offset accepted");
+  if((a = mmap(fd, 0, size, PROT_READ)) == (void*)-1)
+    fail("mmap");
+
+  // The mapping must match the file byte for byte.
+  for(i = 0; i < size; i += n){
+    if((n = read(fd, buf, sizeof(buf))) <= 0)
+      fail("read");
+    if(summap(a + i, n) != summap(buf, n))
+      fail("contents differ");
+  }
+
+  // A child sees the same pages.
+  s1 = summap(a, size);
+  if(fork() == 0){
+    if(summap(a, size) != s1)
+      fail("child contents");
+    exit();
+  }
+  wait();
+  mustfault("write to read-only mapping", writebyte, a);
+
+  // System calls take mapped buffers: pass some of the mapping
+  // through a pipe, but refuse to read() into it.
+  if(pipe(pfd) < 0)
+    fail("pipe");
+  n = size < 256 ? size : 256;
+  if(write(pfd[1], a, n) != n)
+    fail("write from mapping");
+  if(read(pfd[0], buf, n) != n || summap(buf, n) != summap(a, n))
+    fail("pipe contents");
+  if(read(fd, a, 1) != -1)
+    fail("read into read-only mapping");
+  close(pfd[0]);
+  close(pfd[1]);
+
+  // Private writable mapping: writes stay in this process.
+  if((w = mmap(fd, 0, size, PROT_READ|PROT_WRITE)) == (void*)-1)
+    fail("mmap writable");
+  w[0] = w[0] + 1;
+  if(a[0] == w[0])
+    fail("private write reached the shared page");
+  if(fork() == 0){
+    if(w[0] != a[0] + 1)
+      fail("child lost parent's private write");
+    w[0] = 0;
+    exit();
+  }
+  wait();
+  if(w[0] != a[0] + 1)
+    fail("child's write reached the parent");
+
+  // Unmapping the middle splits the mapping.
+  if(size > 3*4096){
+    if(munmap(w + 4096, 4096) < 0)
+      fail("munmap middle");
+    if(w[2*4096] != a[2*4096])
+      fail("upper half of split");
+    mustfault("access to unmapped page", readbyte, w + 4096);
+  }
+  if(munmap(w, size) == 0 && size > 3*4096)
+    fail("munmap across a hole");
+  munmap(w, 4096);
+  if(size > 3*4096)
+    munmap(w + 2*4096, size - 2*4096);
+  mustfault("access after munmap", readbyte, w);
+
+  // Scan the file both ways.
+  close(fd);
+  fd = open(file, O_RDONLY);
+  t0 = rdtsc();
+  s1 = sumread(fd);
+  t1 = (rdtsc() - t0) >> 10;
+  t0 = rdtsc();
+  s2 = summap(a, size);
+  t2 = (rdtsc() - t0) >> 10;
+  close(fd);
+  if(s1 != s2)
+    fail("checksums differ");
+  printf(1, "%s: %d bytes, read %d kcycles, mmap %d kcycles\n", file, size, t1, t2);
+
+  munmap(a, size);
+  printf(1, "mmaptest: ok\n");
+  exit();
+}
@@ -2,6 +2,7 @@
 // x86 memory management unit (MMU).
 
 // Eflags register
+#define FL_TF           0x00000100      // Trap Flag
 #define FL_IF           0x00000200      // Interrupt Enable
 
 // Control Register flags
@@ -11,15 +12,24 @@
 
 #define CR4_PSE         0x00000010      // Page size extension
 
+// Model specific registers
+#define MSR_SYSENTER_CS  0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
+// cpuid leaf 1 %edx feature bits
+#define CPUID_SEP       0x00000800      // sysenter/sysexit
+
 // various segment selectors.
 #define SEG_KCODE 1  // kernel code
 #define SEG_KDATA 2  // kernel data+stack
 #define SEG_UCODE 3  // user code
 #define SEG_UDATA 4  // user data+stack
 #define SEG_TSS   5  // this process's task state
+#define SEG_DFTSS 6  // double fault task state
 
 // cpu->gdt[NSEGS] holds the above segments.
-#define NSEGS     6
+#define NSEGS     7
 
 #ifndef __ASSEMBLER__
 // Segment Descriptor
@@ -58,6 +68,7 @@ struct segdesc {
 #define STA_R       0x2     // Readable (executable segments)
 
 // System segment type bits
+#define STS_TG      0x5     // Task Gate
 #define STS_T32A    0x9     // Available 32-bit TSS
 #define STS_IG32    0xE     // 32-bit Interrupt Gate
 #define STS_TG32    0xF     // 32-bit Trap Gate
@@ -83,6 +94,7 @@ struct segdesc {
 #define NPDENTRIES      1024    // # directory entries per page directory
 #define NPTENTRIES      1024    // # PTEs per page table
 #define PGSIZE          4096    // bytes mapped by a page
+#define SUPERPGSIZE     (NPTENTRIES*PGSIZE) // bytes mapped by a PTE_PS entry
 
 #define PTXSHIFT        12      // offset of PTX in a linear address
 #define PDXSHIFT        22      // offset of PDX in a linear address
@@ -94,7 +106,20 @@ struct segdesc {
 #define PTE_P           0x001   // Present
 #define PTE_W           0x002   // Writeable
 #define PTE_U           0x004   // User
+#define PTE_A           0x020   // Accessed
+#define PTE_D           0x040   // Dirty
 #define PTE_PS          0x080   // Page Size
+#define PTE_COW         0x200   // Copy-on-write (available to software)
+#define PTE_SWAP        0x400   // Not present: paged out, slot in PTE_ADDR
+#define PTE_SHM         0x800   // Superpage of separately counted pages
+
+// Page fault error code bits
+#define FEC_PR          0x001   // Page was present (protection fault)
+#define FEC_WR          0x002   // Fault was a write
+
+// Page fault handlers return this, not -1, when they could not
+// get memory for the page; see pagefault().
+#define FAULT_NOMEM     (-2)
 
 // Address in page table or page directory entry
 #define PTE_ADDR(pte)   ((uint)(pte) & ~0xFFF)
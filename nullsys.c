@@ -0,0 +1,61 @@
+// nullsys: time a null system call entered with int $T_SYSCALL
+// and with sysenter.  Usage: nullsys [log2 iterations]
+// getpid is the null call: the kernel does no work for it
+// beyond the common system call path.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "x86.h"
+#include "traps.h"
+#include "syscall.h"
+#include "kinfo.h"
+
+static inline int
+intcall(int num)
+{
+  int ret;
+
+  asm volatile("int %1" : "=a" (ret) : "i" (T_SYSCALL), "a" (num) : "memory");
+  return ret;
+}
+
+static inline int
+sysentercall(int num)
+{
+  int ret;
+
+  asm volatile("movl %%esp, %%ecx\n\t"
+               "movl $1f, %%edx\n\t"
+               "sysenter\n"
+               "1:"
+               : "=a" (ret) : "a" (num) : "ecx", "edx", "memory");
+  return ret;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, shift, n;
+  uint64 t0, tint, tsysenter;
+
+  shift = argc > 1 ? atoi(argv[1]) : 14;
+  n = 1 << shift;
+
+  t0 = rdtsc();
+  for(i = 0; i < n; i++)
+    intcall(SYS_getpid);
+  tint = rdtsc() - t0;
+  printf(1, "int $T_SYSCALL: %d cycles/call\n", (uint)(tint >> shift));
+
+  if(((struct kinfo*)KINFO)->sysenter == 0){
+    printf(1, "sysenter: not supported\n");
+    exit();
+  }
+  t0 = rdtsc();
+  for(i = 0; i < n; i++)
+    sysentercall(SYS_getpid);
+  tsysenter = rdtsc() - t0;
+  printf(1, "sysenter: %d cycles/call\n", (uint)(tsysenter >> shift));
+  exit();
+}
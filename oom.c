@@ -0,0 +1,236 @@
+// Memory limits and the out-of-memory killer.
+//
+// A process is charged a page for every page of its address
+// space below sz, whether or not the page is in memory yet, and
+// for every page of its writable file mappings, which fill with
+// private copies as they are written.  A limit is checked where
+// memory is asked for: sbrk, exec, fork, spawn and mmap.  So
+// running into it is a failed call, not a fault later on.  Page
+// tables are not charged; there is at most one for each 4MB
+// charged.  System call tracing writes into a fixed ring and
+// allocates nothing.  Every process is also in a memory group, which pays
+// for the address spaces of all its members and for the shm
+// segments they create.  memlimit() gives a process a limit of
+// its own, or puts it in a new group with a limit for the group;
+// children inherit both.  Processes start out in the root group,
+// which has no limit.
+//
+// Limits keep one process or group from taking all of memory;
+// they do not make the promises add up to less than there is.
+// When a page fault finds no free memory even after kswapd had
+// its chance, oomkill() kills the process with the most pages
+// resident, weighed by its priority number, and the fault waits
+// for that memory to come back.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "memstat.h"
+#include "spinlock.h"
+
+#define NPAGES(sz) (PGROUNDUP(sz) / PGSIZE)
+#define OOMTRIES   200  // ticks a fault waits for victims to exit
+
+struct memgrp {
+  int ref;       // member processes and shm segments charged to it
+  uint limit;    // pages, or 0 for none
+  uint used;     // pages charged
+};
+
+struct {
+  struct spinlock lock;
+  struct memgrp grp[NPROC];  // grp[0] is the root group
+  int victim;                // pid oomkill() killed last
+} mlimits;
+
+void
+oominit(void)
+{
+  initlock(&mlimits.lock, "mlimits");
+  mlimits.grp[0].ref = 1;    // for good
+}
+
+// Would n more pages take p or its group past a limit?
+// Caller holds mlimits.lock.
+static int
+overlimit(struct proc *p, uint n)
+{
+  struct memgrp *g = p->mgrp;
+
+  return (p->memlimit && p->mempages + n > p->memlimit) ||
+         (g->limit && g->used + n > g->limit);
+}
+
+// Put the new process p in parent's group with parent's limit,
+// or in the root group if parent is 0, and charge it for sz
+// bytes of address space.  Fails if that is over a limit.
+int
+memadd(struct proc *parent, struct proc *p, uint sz)
+{
+  acquire(&mlimits.lock);
+  p->mgrp = parent ? parent->mgrp : &mlimits.grp[0];
+  p->memlimit = parent ? parent->memlimit : 0;
+  p->mempages = 0;
+  if(overlimit(p, NPAGES(sz))){
+    p->mgrp = 0;
+    release(&mlimits.lock);
+    return -1;
+  }
+  p->mgrp->ref++;
+  p->mgrp->used += NPAGES(sz);
+  p->mempages = NPAGES(sz);
+  release(&mlimits.lock);
+  return 0;
+}
+
+// p is going away: give back its charge and leave its group.
+void
+memexit(struct proc *p)
+{
+  if(p->mgrp == 0)
+    return;
+  acquire(&mlimits.lock);
+  p->mgrp->used -= p->mempages;
+  p->mgrp->ref--;
+  p->mgrp = 0;
+  p->mempages = 0;
+  release(&mlimits.lock);
+}
+
+// p's address space goes from oldsz to newsz bytes.  Growth
+// fails, charging nothing, if it is over a limit.
+int
+memresize(struct proc *p, uint oldsz, uint newsz)
+{
+  uint o, n;
+
+  o = NPAGES(oldsz);
+  n = NPAGES(newsz);
+  acquire(&mlimits.lock);
+  if(n > o && overlimit(p, n - o)){
+    release(&mlimits.lock);
+    return -1;
+  }
+  p->mempages += n - o;
+  p->mgrp->used += n - o;
+  release(&mlimits.lock);
+  return 0;
+}
+
+// Charge n pages that outlive p, like an shm segment, to p's
+// group.  Returns the group, with a reference for the caller
+// to hand to memuncharge(), or 0 if that is over its limit.
+struct memgrp*
+memcharge(struct proc *p, uint n)
+{
+  struct memgrp *g = p->mgrp;
+
+  acquire(&mlimits.lock);
+  if(g->limit && g->used + n > g->limit){
+    release(&mlimits.lock);
+    return 0;
+  }
+  g->used += n;
+  g->ref++;
+  release(&mlimits.lock);
+  return g;
+}
+
+void
+memuncharge(struct memgrp *g, uint n)
+{
+  acquire(&mlimits.lock);
+  g->used -= n;
+  g->ref--;
+  release(&mlimits.lock);
+}
+
+// Limit the current process to pages pages (0: no limit), or
+// with group set, move it to a new group with that limit.
+int
+memlimit(uint pages, int group)
+{
+  struct proc *p = myproc();
+  struct memgrp *g;
+
+  acquire(&mlimits.lock);
+  if(pages && p->mempages > pages){
+    release(&mlimits.lock);
+    return -1;
+  }
+  if(!group){
+    p->memlimit = pages;
+    release(&mlimits.lock);
+    return 0;
+  }
+  for(g = &mlimits.grp[1]; g < &mlimits.grp[NPROC]; g++)
+    if(g->ref == 0)
+      break;
+  if(g == &mlimits.grp[NPROC]){
+    release(&mlimits.lock);
+    return -1;
+  }
+  p->mgrp->used -= p->mempages;
+  p->mgrp->ref--;
+  g->ref = 1;
+  g->limit = pages;
+  g->used = p->mempages;
+  p->mgrp = g;
+  release(&mlimits.lock);
+  return 0;
+}
+
+// A page fault in p could not get memory, and swapwait() gave
+// up.  Kill the process whose memory helps most, unless the last
+// one killed has not let go of its memory yet, and wait a tick
+// for it.  Returns 0 to have the fault retried, or -1 if killing
+// will not help: p itself is the best victim, or try says the
+// fault has waited long enough.
+int
+oomkill(struct proc *p, int try)
+{
+  struct proc *ptab, *q, *victim;
+  struct procmemstat ps;
+  uint score, best, pri;
+
+  if(try >= OOMTRIES)
+    return -1;
+  ptab = lockptable();
+  for(q = ptab; q < &ptab[NPROC]; q++)
+    if(q->pid == mlimits.victim && q->state != UNUSED)
+      break;
+  if(q == &ptab[NPROC]){
+    victim = 0;
+    best = 0;
+    for(q = ptab; q < &ptab[NPROC]; q++){
+      if(q->state == UNUSED || q->state == EMBRYO || q->state == ZOMBIE ||
+         q->killed || q->pid == 1 || q->sz == 0)
+        continue;
+      uvmusage(q->pgdir, &ps);
+      pri = q->priority > 0 ? q->priority : 0;
+      score = ps.rss * (pri + 1);
+      if(score > best){
+        best = score;
+        victim = q;
+      }
+    }
+    if(victim == 0 || victim == p){
+      unlockptable();
+      return -1;
+    }
+    cprintf("oom: killed pid %d %s\n", victim->pid, victim->name);
+    victim->killed = 1;
+    if(victim->state == SLEEPING)
+      victim->state = RUNNABLE;
+    mlimits.victim = victim->pid;
+  }
+  unlockptable();
+
+  acquire(&tickslock);
+  sleep(&ticks, &tickslock);
+  release(&tickslock);
+  return 0;
+}
@@ -6,9 +6,20 @@
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
+#define SWAPDEV       2  // device number of the swap disk
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
-
+#define FSSIZE       4000  // size of file system in blocks
+#define NTRACE       1024  // records in the /dev/trace ring
+#define NSYSHIST        8  // recent syscalls remembered per process
+#define MAXSYSARGS      4  // max arguments captured per syscall
+#define SYSSTRLEN      16  // bytes of a string argument captured
+#define MAXORDER       10  // largest kalloc_pages block is 2^MAXORDER pages
+#define NVMA            8  // file mappings per process
+#define NPCACHE       256  // pages in the file page cache
+#define NREADAHEAD      4  // pages mapped per fault on a file mapping
+#define NSWAP        2048  // pages of swap space; see swap.img in Makefile
+#define SWAPLOW        64  // kswapd pages out below this many free pages
+#define SWAPHIGH      128  // ... until this many are free again
@@ -0,0 +1,150 @@
+// Page cache: whole pages of files, keyed by (device, inode,
+// offset), for mmap() and for program text and data.  Every
+// mapping of a cached page shares the one physical copy
+// read-only.  The cache holds one kalloc reference to each page
+// and each mapping holds another, so a slot is only recycled
+// once nobody maps its page any more.
+//
+// writei() and itrunc() drop the cached pages of an inode, so
+// later faults see the new contents; pages that are already
+// mapped keep the data they were read with.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "memstat.h"
+
+struct pcent {
+  uint dev;
+  uint inum;
+  uint off;        // file offset, page aligned
+  char *page;      // 0 if the slot is free
+};
+
+struct {
+  struct spinlock lock;
+  struct pcent ent[NPCACHE];
+  uint hand;       // next slot to consider for reuse
+  uint hits;
+  uint misses;
+} pcache;
+
+void
+pcinit(void)
+{
+  initlock(&pcache.lock, "pcache");
+}
+
+// Caller holds pcache.lock.
+static struct pcent*
+pclookup(uint dev, uint inum, uint off)
+{
+  struct pcent *e;
+
+  for(e = pcache.ent; e < &pcache.ent[NPCACHE]; e++)
+    if(e->page && e->dev == dev && e->inum == inum && e->off == off)
+      return e;
+  return 0;
+}
+
+// Find a slot for a new page: a free one, or else one whose
+// page only the cache still refers to.  Caller holds pcache.lock.
+static struct pcent*
+pcslot(void)
+{
+  struct pcent *e;
+  int i;
+
+  for(e = pcache.ent; e < &pcache.ent[NPCACHE]; e++)
+    if(e->page == 0)
+      return e;
+  for(i = 0; i < NPCACHE; i++){
+    e = &pcache.ent[pcache.hand++ % NPCACHE];
+    if(krefcount(e->page) == 1){
+      kfree(e->page);
+      e->page = 0;
+      return e;
+    }
+  }
+  return 0;
+}
+
+// Return the page holding bytes [off, off+PGSIZE) of ip, with
+// a reference for the caller; bytes past the end of the file
+// read as zero.  off must be page aligned.  Caller holds ip's
+// lock, so no write can slip in between the read and the insert
+// and leave a stale page behind.  Returns 0 if memory is short.
+char*
+pcget(struct inode *ip, uint off)
+{
+  struct pcent *e;
+  char *page;
+
+  acquire(&pcache.lock);
+  if((e = pclookup(ip->dev, ip->inum, off)) != 0){
+    kref(e->page);
+    pcache.hits++;
+    release(&pcache.lock);
+    return e->page;
+  }
+  pcache.misses++;
+  release(&pcache.lock);
+
+  if((page = kalloc_zeroed(KM_PCACHE)) == 0)
+    return 0;
+  if(off < ip->size)
+    readi(ip, page, off, PGSIZE);
+  ip->pcached = 1;
+  acquire(&pcache.lock);
+  if((e = pcslot()) != 0){
+    e->dev = ip->dev;
+    e->inum = ip->inum;
+    e->off = off;
+    e->page = page;
+    kref(page);
+  }
+  release(&pcache.lock);
+  return page;
+}
+
+// Forget the cached pages of ip.  Caller holds ip's lock.
+// Only the first write after ip's pages were cached pays for
+// the scan.
+void
+pcinval(struct inode *ip)
+{
+  struct pcent *e;
+
+  if(!ip->pcached)
+    return;
+  ip->pcached = 0;
+  acquire(&pcache.lock);
+  for(e = pcache.ent; e < &pcache.ent[NPCACHE]; e++){
+    if(e->page && e->dev == ip->dev && e->inum == ip->inum){
+      kfree(e->page);
+      e->page = 0;
+    }
+  }
+  release(&pcache.lock);
+}
+
+// Fill in the page cache part of a memstat.
+void
+pcstat(struct memstat *ms)
+{
+  struct pcent *e;
+
+  acquire(&pcache.lock);
+  ms->pcpages = 0;
+  for(e = pcache.ent; e < &pcache.ent[NPCACHE]; e++)
+    if(e->page)
+      ms->pcpages++;
+  ms->pchits = pcache.hits;
+  ms->pcmisses = pcache.misses;
+  release(&pcache.lock);
+}
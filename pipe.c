@@ -4,6 +4,7 @@
 #include "date.h"
 #include "mmu.h"
 #include "proc.h"
+#include "memstat.h"
 #include "fs.h"
 #include "spinlock.h"
 #include "sleeplock.h"
@@ -29,7 +30,7 @@ pipealloc(struct file **f0, struct file **f1)
   *f0 = *f1 = 0;
   if((*f0 = filealloc()) == 0 || (*f1 = filealloc()) == 0)
     goto bad;
-  if((p = (struct pipe*)kalloc()) == 0)
+  if((p = (struct pipe*)kalloc(KM_PIPE)) == 0)
     goto bad;
   p->readopen = 1;
   p->writeopen = 1;
@@ -6,7 +6,9 @@
 #include "mmu.h"
 #include "x86.h"
 #include "proc.h"
+#include "memstat.h"
 #include "spinlock.h"
+#include "kinfo.h"
 
 struct {
   struct spinlock lock;
@@ -77,7 +79,6 @@ allocproc(void)
 {
   struct proc *p;
   char *sp;
-  int i;
 
   acquire(&ptable.lock);
 
@@ -95,18 +96,29 @@ found:
   p->priority = 10;
   p->MFQpriority = 1;
   p->tickets = 100;
-  for (i = 0; i < 41; ++i)
-  {
-    p->syscalls[i].count = 0;
-  }
+  memset(p->sysstat, 0, sizeof(p->sysstat));
+  p->nsyshist = 0;
+  p->traceflags = 0;
+  p->ringva = 0;
+  p->insyscall = 0;
+  p->superpages = 0;
+  p->mgrp = 0;
+  memset(p->vma, 0, sizeof(p->vma));
 
   release(&ptable.lock);
 
   // Allocate kernel stack.
-  if((p->kstack = kalloc()) == 0){
+  if((p->kstack = kstackalloc()) == 0){
+    p->state = UNUSED;
+    return 0;
+  }
+  if((p->kpinfo = (struct kpinfo*)kalloc_zeroed(KM_KINFO)) == 0){
+    kstackfree(p->kstack);
+    p->kstack = 0;
     p->state = UNUSED;
     return 0;
   }
+  p->kpinfo->pid = p->pid;
   sp = p->kstack + KSTACKSIZE;
 
   // Leave room for trap frame.
@@ -137,10 +149,11 @@ userinit(void)
   p = allocproc();
   
   initproc = p;
-  if((p->pgdir = setupkvm()) == 0)
+  if((p->pgdir = setupkvm()) == 0 || setupkinfo(p->pgdir, p) < 0)
     panic("userinit: out of memory?");
   inituvm(p->pgdir, _binary_initcode_start, (int)_binary_initcode_size);
   p->sz = PGSIZE;
+  memadd(0, p, p->sz);
   memset(p->tf, 0, sizeof(*p->tf));
   p->tf->cs = (SEG_UCODE << 3) | DPL_USER;
   p->tf->ds = (SEG_UDATA << 3) | DPL_USER;
@@ -164,7 +177,78 @@ userinit(void)
   release(&ptable.lock);
 }
 
+// First scheduling of a kernel thread: run the function that
+// kthread() left in its otherwise unused trap frame.
+static void
+kthreadret(void)
+{
+  // Still holding ptable.lock from scheduler.
+  release(&ptable.lock);
+  ((void (*)(void))myproc()->tf->eip)();
+  panic("kthread returned");
+}
+
+// Start a kernel thread running fn, which must not return.
+// It has no user memory and is a child of init.
+void
+kthread(char *name, void (*fn)(void))
+{
+  struct proc *p;
+
+  if((p = allocproc()) == 0 || (p->pgdir = setupkvm()) == 0)
+    panic("kthread");
+  p->sz = 0;
+  memadd(0, p, 0);
+  p->tf->eip = (uint)fn;
+  p->context->eip = (uint)kthreadret;
+  p->parent = initproc;
+  safestrcpy(p->name, name, sizeof(p->name));
+
+  acquire(&ptable.lock);
+  p->state = RUNNABLE;
+  release(&ptable.lock);
+}
+
+// Lock the process table for code outside proc.c that looks
+// at other processes' memory, like swap.c.  Returns the table.
+struct proc*
+lockptable(void)
+{
+  acquire(&ptable.lock);
+  return ptable.proc;
+}
+
+void
+unlockptable(void)
+{
+  release(&ptable.lock);
+}
+
+// Fill in the per-process part of a memstat.
+void
+procmemstat(struct memstat *ms)
+{
+  struct proc *p;
+  struct procmemstat *ps;
+
+  ms->nproc = 0;
+  acquire(&ptable.lock);
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    if(p->state == UNUSED || p->state == EMBRYO || p->pgdir == 0)
+      continue;
+    ps = &ms->proc[ms->nproc++];
+    ps->pid = p->pid;
+    safestrcpy(ps->name, p->name, sizeof(ps->name));
+    uvmusage(p->pgdir, ps);
+    ps->charged = p->mempages;
+    ps->limit = p->memlimit;
+  }
+  release(&ptable.lock);
+}
+
 // Grow current process's memory by n bytes.
+// Growth only reserves address space; pagefault() maps zeroed
+// pages on first touch.
 // Return 0 on success, -1 on failure.
 int
 growproc(int n)
@@ -174,14 +258,19 @@ growproc(int n)
 
   sz = curproc->sz;
   if(n > 0){
-    if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
+    if(sz + n < sz || sz + n >= KERNBASE ||
+       vmaoverlap(curproc, sz, sz + n) ||
+       uvmmapped(curproc->pgdir, PGROUNDUP(sz), sz + n) ||
+       memresize(curproc, sz, sz + n) < 0)
       return -1;
+    sz += n;
   } else if(n < 0){
     if((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
       return -1;
+    memresize(curproc, curproc->sz, sz);
+    lcr3(V2P(curproc->pgdir));  // flush the freed pages' TLB entries
   }
   curproc->sz = sz;
-  switchuvm(curproc);
   return 0;
 }
 
@@ -201,9 +290,17 @@ fork(void)
   }
 
   // Copy process state from proc.
-  if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
-    kfree(np->kstack);
+  if(memadd(curproc, np, curproc->sz + vmacommit(curproc)) < 0 ||
+     (np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0 ||
+     setupkinfo(np->pgdir, np) < 0 ||
+     vmafork(curproc, np) < 0){
+    memexit(np);
+    if(np->pgdir)
+      freevm(np->pgdir);
+    kstackfree(np->kstack);
     np->kstack = 0;
+    kfree((char*)np->kpinfo);
+    np->kpinfo = 0;
     np->state = UNUSED;
     return -1;
   }
@@ -220,6 +317,72 @@ fork(void)
   np->cwd = idup(curproc->cwd);
 
   safestrcpy(np->name, curproc->name, sizeof(curproc->name));
+  np->traceflags = curproc->traceflags;
+  np->ringva = curproc->ringva;
+  np->superpages = curproc->superpages;
+
+  pid = np->pid;
+
+  acquire(&ptable.lock);
+
+  np->state = RUNNABLE;
+
+  release(&ptable.lock);
+
+  return pid;
+}
+
+// Create a child process running the program at path, built
+// straight from the ELF file instead of from a copy of the
+// caller.  The child's fd i is the caller's fd fdmap[i] for
+// i < nfd; fdmap[i] == -1 and all fds from nfd on are closed.
+// Returns the child's pid, or -1.
+int
+spawn(char *path, char **argv, int *fdmap, int nfd)
+{
+  int i, pid;
+  struct image img;
+  struct proc *np;
+  struct proc *curproc = myproc();
+
+  if(nfd < 0 || nfd > NOFILE)
+    return -1;
+  for(i = 0; i < nfd; i++)
+    if(fdmap[i] != -1 &&
+       (fdmap[i] < 0 || fdmap[i] >= NOFILE || curproc->ofile[fdmap[i]] == 0))
+      return -1;
+
+  if((np = allocproc()) == 0)
+    return -1;
+  if(loadimage(np, path, argv, &img) < 0)
+    goto bad;
+  if(memadd(curproc, np, img.sz) < 0){
+    freevm(img.pgdir);
+    vmaclose(img.vma);
+    goto bad;
+  }
+  np->pgdir = img.pgdir;
+  np->sz = img.sz;
+  memmove(np->vma, img.vma, sizeof(img.vma));
+  np->parent = curproc;
+  memset(np->tf, 0, sizeof(*np->tf));
+  np->tf->cs = (SEG_UCODE << 3) | DPL_USER;
+  np->tf->ds = (SEG_UDATA << 3) | DPL_USER;
+  np->tf->es = np->tf->ds;
+  np->tf->ss = np->tf->ds;
+  np->tf->eflags = FL_IF;
+  np->tf->eip = img.eip;
+  np->tf->esp = img.esp;
+
+  for(i = 0; i < nfd; i++)
+    if(fdmap[i] != -1)
+      np->ofile[i] = filedup(curproc->ofile[fdmap[i]]);
+  np->cwd = idup(curproc->cwd);
+
+  setprocname(np, path);
+  np->tickets = 500;
+  np->traceflags = curproc->traceflags;
+  np->superpages = curproc->superpages;
 
   pid = np->pid;
 
@@ -230,6 +393,14 @@ fork(void)
   release(&ptable.lock);
 
   return pid;
+
+ bad:
+  kstackfree(np->kstack);
+  np->kstack = 0;
+  kfree((char*)np->kpinfo);
+  np->kpinfo = 0;
+  np->state = UNUSED;
+  return -1;
 }
 
 // Exit the current process.  Does not return.
@@ -253,10 +424,13 @@ exit(void)
     }
   }
 
+  vmaclose(curproc->vma);
   begin_op();
   iput(curproc->cwd);
   end_op();
   curproc->cwd = 0;
+  shmexit(curproc);
+  memexit(curproc);
 
   acquire(&ptable.lock);
 
@@ -298,8 +472,10 @@ wait(void)
       if(p->state == ZOMBIE){
         // Found one.
         pid = p->pid;
-        kfree(p->kstack);
+        kstackfree(p->kstack);
         p->kstack = 0;
+        kfree((char*)p->kpinfo);
+        p->kpinfo = 0;
         freevm(p->pgdir);
         p->pid = 0;
         p->parent = 0;
@@ -339,6 +515,7 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int ran;
   c->proc = 0;
   
   for(;;){
@@ -346,10 +523,12 @@ scheduler(void)
     sti();
 
     // Loop over process table looking for process to run.
+    ran = 0;
     acquire(&ptable.lock);
     for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
       if(p->state != RUNNABLE)
         continue;
+      ran = 1;
 
       // Switch to chosen process.  It is the process's job
       // to release ptable.lock and then reacquire it
@@ -359,14 +538,18 @@ scheduler(void)
       p->state = RUNNING;
 
       swtch(&(c->scheduler), p->context);
-      switchkvm();
 
       // Process is done running for now.
       // It should have changed its p->state before coming back.
+      // Its page table stays loaded until the next one's is.
       c->proc = 0;
     }
+    switchkvm();
     release(&ptable.lock);
 
+    // Nothing to run: use the time to zero a page.
+    if(!ran)
+      kzeroidle();
   }
 }
 
@@ -409,7 +592,6 @@ MFQscheduler(void) {
 			    	p->state = RUNNING;
 
 			    	swtch(&(c->scheduler), p->context);
-			    	switchkvm();
 
 			    	c->proc = 0;
 			    	break;
@@ -442,7 +624,6 @@ MFQscheduler(void) {
 		    	p->state = RUNNING;
 
 		    	swtch(&(c->scheduler), p->context);
-		    	switchkvm();
 
 		    	c->proc = 0;
 			}
@@ -469,7 +650,6 @@ MFQscheduler(void) {
 		    	p->state = RUNNING;
 
 		    	swtch(&(c->scheduler), p->context);
-		    	switchkvm();
 
 		    	c->proc = 0;
 			}
@@ -488,7 +668,10 @@ MFQscheduler(void) {
         else
             MFQpriority = 1;
     }
+    switchkvm();
     release(&ptable.lock);
+    if (found == 0)
+        kzeroidle();
   }
 }
 
@@ -558,7 +741,7 @@ ps(void)
   struct proc *p;
 
   acquire(&ptable.lock);
-  cprintf("NAME\tPID\tSTATE\t\tPRIORITY\tTICKETS\tCTIME\tLEVEL\n");
+  cprintf("NAME\tPID\tSTATE\t\tPRIORITY\tTICKETS\tCTIME\tLEVEL\tVSZ\tRSS\n");
   cprintf("---------------------------------------------------------------------------------------------------\n");
   for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
 	if(p->state == UNUSED)
@@ -589,7 +772,11 @@ ps(void)
     cprintf("\t%d", p->priority);
     cprintf("\t\t%d", p->tickets);
     cprintf("\t%d", p->ctime);
-    cprintf("\t%d\n\n", p->MFQpriority);
+    cprintf("\t%d", p->MFQpriority);
+    if(p->state == ZOMBIE || p->state == EMBRYO)
+      cprintf("\t-\t-\n\n");
+    else
+      cprintf("\t%dK\t%dK\n\n", p->sz / 1024, rsspages(p->pgdir, p->sz) * (PGSIZE / 1024));
   }
   release(&ptable.lock);
 }
@@ -773,107 +960,108 @@ wakeup(void *chan)
   release(&ptable.lock);
 }
 
+// Print the syscall counters and recent history of pid.
+// Records are copied out one at a time under ptable.lock
+// and printed after releasing it.
 int
 invocation_log(int pid)
 {
   struct proc *p;
-  int i, status = -1;
+  struct sysstat st[SYS_CALL_COUNT+1];
+  struct sysrec r;
+  uint i, n;
 
   acquire(&ptable.lock);
   for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-  {
-    if(p->pid == pid){
-      for (i = 0; i < 41; ++i)
-      {
-        if (p->syscalls[i].count > 0)
-        {
-          struct date* d = p->syscalls[i].datelist;
-          struct syscallarg* a = p->syscalls[i].arglist;
-          for (; d != 0 && a != 0; d = d->next)
-          {
-            cprintf("%d syscall : ID :%d NAME:%s DATE: %d:%d:%d %d-%d-%d\n",p->syscalls[i].count, i+1,
-              p->syscalls[i].name, d->date.hour, d->date.minute, d->date.second, d->date.year,
-              d->date.month, d->date.day);
-            if (i == 0 || i == 1 || i == 2 || i == 13 || i == 10 || i == 27 || i == 28)
-              cprintf("%d %s  (%s)\n",p->pid, p->syscalls[i].name, a->type[0]); 
-            if (i == 21 || i == 22 || i == 24 || i == 5 || i == 11 || i == 12 || i == 9 || i == 20 || i == 39 || i == 40)
-              cprintf("%d %s  (%s %d)\n",p->pid, p->syscalls[i].name, a->type[0], a->int_argv[0]);
-            if (i == 23 || i == 33 || i == 34)
-              cprintf("%d %s  (%s %d, %s %d)\n",p->pid, p->syscalls[i].name,
-                a->type[0],a->int_argv[0],
-                a->type[1],a->int_argv[1]);
-            if (i == 3)
-              cprintf("%d %s  (%s 0x%p)\n",p->pid, p->syscalls[i].name, a->type[0], a->intptr_argv);
-            if (i == 4 || i == 15)
-              cprintf("%d %s  (%s %d, %s 0x%p, %s %d)\n",p->pid, p->syscalls[i].name,
-                a->type[0],a->int_argv[0],a->type[1],a->str_argv[0],
-                a->type[2],a->int_argv[1]);
-            if (i == 6)
-                cprintf("%d %s  (%s 0x%p, %s 0x%p)\n",p->pid, p->syscalls[i].name, a->type[0], a->str_argv[0], a->type[1], a->ptr_argv[0]);
-            if (i == 14)
-                cprintf("%d %s  (%s %s, %s %d)\n",p->pid, p->syscalls[i].name, a->type[0], a->str_argv[0], a->type[1], a->int_argv[0]);
-            if (i == 17 || i == 19 || i == 8)
-                cprintf("%d %s  (%s %s)\n",p->pid, p->syscalls[i].name, a->type[0], a->str_argv[0]);
-            if (i == 18)
-                cprintf("%d %s  (%s %s, %s %s)\n",p->pid, p->syscalls[i].name, a->type[0], a->str_argv[0], a->type[1], a->str_argv[1]);
-            if (i == 7)
-                cprintf("%d %s  (%s %d, %s 0x%p)\n",p->pid, p->syscalls[i].name, a->type[0], a->int_argv[0], a->type[1], a->st);
-            if (i == 16)
-                cprintf("%d %s  (%s %s, %s %d, %s %d)\n",p->pid, p->syscalls[i].name, a->type[0], a->str_argv[0], a->type[1], a->int_argv[0],
-                  a->type[2], a->int_argv[1]);
-            if (i == 38)
-                cprintf("%d %s  (%s %d, %s %d, %s %d)\n",p->pid, p->syscalls[i].name, a->type[0], a->int_argv[0], a->type[1], a->int_argv[1],
-                  a->type[2], a->int_argv[2]);
-
-            a = a->next;
-          }
-          status = 0;
-        } 
-      }
-    }
+    if(p->pid == pid && p->state != UNUSED)
+      break;
+  if(p == &ptable.proc[NPROC]){
+    release(&ptable.lock);
+    cprintf("pid not found!\n");
+    return -1;
   }
-
+  memmove(st, p->sysstat, sizeof(st));
+  n = p->nsyshist;
   release(&ptable.lock);
 
-  if (status == -1)
-    cprintf("pid not found!\n");
+  for(i = 1; i <= SYS_CALL_COUNT; i++)
+    if(st[i].count > 0)
+      cprintf("%d syscall : ID :%d NAME:%s LAST: %d\n", st[i].count, i,
+              syscallname(i), st[i].last);
 
-  return status;
+  for(i = n > NSYSHIST ? n - NSYSHIST : 0; i < n; i++){
+    acquire(&ptable.lock);
+    if(p->pid != pid){
+      release(&ptable.lock);
+      break;
+    }
+    r = p->syshist[i % NSYSHIST];
+    release(&ptable.lock);
+    printsysrec(pid, &r);
+  }
+  return 0;
 }
 
+// Set the TRACE_* flags of pid.
 int
-get_syscall_count(int pid, int sysnum)
+settrace(int pid, int flags)
 {
   struct proc *p;
-  int count = 0, status = -1;
 
   acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-  {
-     if (p->pid == pid)
-     {
-       count = p->syscalls[sysnum-1].count;
-       status = 0;
-     }
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    if(p->pid == pid && p->state != UNUSED){
+      p->traceflags = flags;
+      release(&ptable.lock);
+      return 0;
+    }
   }
+  release(&ptable.lock);
+  return -1;
+}
 
-  if(status == -1)
-  {
-    cprintf("pid not found!\n");
-    release(&ptable.lock);
-    return -1;
+// Copy the syscall counters of pid into st.
+int
+getsysstat(int pid, struct sysstat *st)
+{
+  struct proc *p;
+
+  acquire(&ptable.lock);
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    if(p->pid == pid && p->state != UNUSED){
+      memmove(st, p->sysstat, sizeof(p->sysstat));
+      release(&ptable.lock);
+      return 0;
+    }
   }
   release(&ptable.lock);
-  return count;
+  return -1;
 }
 
-void 
-log_syscalls(struct node* first_proc)
+// Number of times pid has made system call sysnum.
+int
+get_syscall_count(int pid, int sysnum)
 {
-  for(struct node* n = first_proc; n != 0; n = n->next){
-    cprintf("Syscall name: %s @ DATE: %d:%d:%d %d-%d-%d by Process: %d\n", n -> name, n->date.hour, n->date.minute, n->date.second, n->date.year,
-      n->date.month, n->date.day, n -> pid);
+  struct proc *p;
+  int count = -1;
+
+  if(sysnum <= 0 || sysnum > SYS_CALL_COUNT)
+    return -1;
+
+  // A process reading its own counters needs no lock.
+  p = myproc();
+  if(p->pid == pid)
+    return p->sysstat[sysnum].count;
+
+  acquire(&ptable.lock);
+  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    if(p->pid == pid && p->state != UNUSED){
+      count = p->sysstat[sysnum].count;
+      break;
+    }
   }
+  release(&ptable.lock);
+  return count;
 }
 
 // Kill the process with the given pid.
@@ -927,8 +1115,8 @@ procdump(void)
       state = states[p->state];
     else
       state = "???";
-    for(i=0;i<24;i++)
-      count += p->syscalls[i].count;
+    for(i=1;i<=SYS_CALL_COUNT;i++)
+      count += p->sysstat[i].count;
     cprintf("%d %s %s count:%d", p->pid, state, p->name,count);
     if(p->state == SLEEPING){
       getcallerpcs((uint*)p->context->ebp+2, pc);
@@ -1,15 +1,18 @@
-#define SYS_CALL_COUNT 41
+#define SYS_CALL_COUNT 50
 
 // Per-CPU state
 struct cpu {
   uchar apicid;                // Local APIC ID
   struct context *scheduler;   // swtch() here to enter scheduler
   struct taskstate ts;         // Used by x86 to find stack for interrupt
+  struct taskstate dfts;       // Double fault task (see trap.c)
+  char dfstack[2048];          // Its stack
   struct segdesc gdt[NSEGS];   // x86 global descriptor table
   volatile uint started;       // Has the CPU started?
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
+  uint cr3;                    // Page directory loaded in %cr3, or 0
 };
 
 extern struct cpu cpus[NCPU];
@@ -34,29 +37,40 @@ struct context {
   uint eip;
 };
 
-struct syscallarg {
-  char type[8][30];
-  int int_argv[8];
-  int* intptr_argv;
-  char* str_argv[8];
-  char** ptr_argv[8];
-  struct stat* st;
-  struct syscallarg* next;
+// Per-process counters for one system call,
+// indexed directly by system call number.
+struct sysstat {
+  uint count;                  // Number of calls
+  uint last;                   // ticks at the most recent call
+  uint64 cycles;               // Total TSC cycles spent in the call
 };
 
-struct date {
-  struct rtcdate date;
-  int time;
-  struct date* next;
+// One entry of the per-process recent-call history ring.
+// Arguments are raw values, typed by sysdescs[num].
+struct sysrec {
+  int num;                     // System call number
+  uint ticks;                  // ticks when the call returned
+  int argv[MAXSYSARGS];        // Argument values
+  char str[SYSSTRLEN];         // First string argument, if traced
 };
 
-struct systemcall {
-  uint count;
-  struct date* datelist;
-  struct date* datelist_end;
-  char name[30];
-  struct syscallarg* arglist;
-  struct syscallarg* arglist_end;
+// A file mapping made by mmap() or exec(), see mmap.c.
+struct vma {
+  uint start;                  // First mapped address, page aligned
+  uint end;                    // One past the last mapped address
+  uint fileend;                // Addresses from here to end read as zero
+  uint off;                    // File offset of start
+  int prot;                    // PROT_READ, PROT_WRITE
+  struct inode *ip;            // Mapped file; 0 if the slot is free
+};
+
+// A freshly loaded program, from loadimage().
+struct image {
+  pde_t *pgdir;
+  uint sz;                     // Size of its memory (bytes)
+  uint eip;                    // Entry point
+  uint esp;                    // Initial stack pointer, argv pushed
+  struct vma vma[NVMA];        // Segments to fault in from the file
 };
 
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
@@ -66,6 +80,7 @@ struct proc {
   uint sz;                     // Size of process memory (bytes)
   pde_t* pgdir;                // Page table
   char *kstack;                // Bottom of kernel stack for this process
+  struct kpinfo *kpinfo;       // Page mapped read-only at KPINFO
   enum procstate state;        // Process state
   int pid;                     // Process ID
   struct proc *parent;         // Parent process
@@ -76,7 +91,17 @@ struct proc {
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
-  struct systemcall syscalls[SYS_CALL_COUNT];
+  struct sysstat sysstat[SYS_CALL_COUNT+1]; // Syscall counters, by number
+  struct sysrec syshist[NSYSHIST]; // Most recent system calls
+  uint nsyshist;               // Calls recorded in syshist so far
+  int traceflags;              // TRACE_* flags, inherited by children
+  uint ringva;                 // User address of the syscall ring, or 0
+  int insyscall;               // In a system call: do not page out
+  int superpages;              // Map the heap with 4MB pages; see vm.c
+  struct memgrp *mgrp;         // Memory group charged for it (see oom.c)
+  uint mempages;               // Pages of address space charged to it
+  uint memlimit;               // Its own limit on mempages, or 0
+  struct vma vma[NVMA];        // Program segments and mmap()ed files
   int priority;                // Process priority
   int MFQpriority;
   int ctime;                   // Process creation time
@@ -86,13 +111,6 @@ struct proc {
   int tickets;                 // Process tickets used in LOTTERY scheduling algorithm
 };
 
-struct node{
-  char name[30];
-  struct rtcdate date;
-  int pid;
-  struct node* next;
-};
-
 // Process memory is laid out contiguously, low addresses first:
 //   text
 //   original data and bss
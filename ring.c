@@ -0,0 +1,81 @@
+// Batched system calls.
+// A process registers one page of its own memory as a struct ring
+// with ring_setup(); ring_enter() then runs the queued submissions
+// through the ordinary syscalls[] table, one trap for the batch.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "syscall.h"
+#include "ring.h"
+
+// Calls that may be batched.  Anything that replaces or ends
+// the process, or resizes its memory, must go through a trap.
+static int
+ringok(int num)
+{
+  switch(num){
+  case SYS_read:
+  case SYS_write:
+  case SYS_open:
+  case SYS_close:
+  case SYS_fstat:
+  case SYS_dup:
+    return 1;
+  }
+  return 0;
+}
+
+// Register the ring at user address va, or unregister if va is 0.
+int
+ringsetup(uint va)
+{
+  struct proc *p = myproc();
+
+  if(va != 0 && (va % PGSIZE != 0 || va + PGSIZE > p->sz))
+    return -1;
+  p->ringva = va;
+  return 0;
+}
+
+// Run up to n queued submissions (all of them if n <= 0),
+// stopping early if the completion ring fills up.
+// Returns the number of completions posted.
+int
+ringenter(int n)
+{
+  struct proc *p = myproc();
+  struct ring *r;
+  struct sqe *e;
+  struct cqe *c;
+  uint head;
+  int done, num, ret;
+
+  // The ring is read through the user mapping, so make sure
+  // sbrk has not taken it away since ring_setup.
+  if(p->ringva == 0 || p->ringva + PGSIZE > p->sz)
+    return -1;
+  if(prefault(p, p->ringva, PGSIZE, 1) < 0)
+    return -1;
+  r = (struct ring*)p->ringva;
+  for(done = 0; n <= 0 || done < n; done++){
+    head = r->sqhead;
+    if(head == r->sqtail || r->cqtail - r->cqhead >= NRING || p->killed)
+      break;
+    e = &r->sq[head % NRING];
+    num = e->num;
+    if(ringok(num))
+      ret = syscallat(num, (uint)&e->num);
+    else
+      ret = -1;
+    c = &r->cq[r->cqtail % NRING];
+    c->udata = e->udata;
+    c->ret = ret;
+    r->cqtail++;
+    r->sqhead = head + 1;
+  }
+  return done;
+}
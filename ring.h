@@ -0,0 +1,27 @@
+// Batched system call submission and completion rings.
+// User space fills sq[sqtail % NRING] and bumps sqtail, then calls
+// ring_enter(); the kernel runs entries from sqhead on, posting a
+// completion for each at cq[cqtail % NRING].  Include param.h first.
+
+#define NRING 64
+
+struct sqe {
+  int num;               // System call number (SYS_*)
+  int arg[MAXSYSARGS];   // Arguments, as they would be on the stack
+  uint udata;            // Copied to the completion
+};
+
+struct cqe {
+  uint udata;            // From the submission
+  int ret;               // Return value of the call
+};
+
+// Occupies one page-aligned page of user memory.
+struct ring {
+  volatile uint sqhead;  // Next submission the kernel will take
+  volatile uint sqtail;  // Next submission user space will fill
+  volatile uint cqhead;  // Next completion user space will take
+  volatile uint cqtail;  // Next completion the kernel will fill
+  struct sqe sq[NRING];
+  struct cqe cq[NRING];
+};
@@ -0,0 +1,109 @@
+// ringbench: compare small writes and reads issued one trap
+// per call with the same calls batched through ring_enter.
+// Usage: ringbench [ncalls] [size]
+
+#include "types.h"
+#include "param.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "x86.h"
+#include "syscall.h"
+#include "ring.h"
+
+#define PGSIZE 4096
+
+char buf[512];
+
+// Return a page-aligned page of fresh memory.
+struct ring*
+ringalloc(void)
+{
+  char *p;
+
+  p = sbrk(0);
+  if((uint)p % PGSIZE)
+    sbrk(PGSIZE - (uint)p % PGSIZE);
+  p = sbrk(PGSIZE);
+  if(p == (char*)-1)
+    return 0;
+  memset(p, 0, PGSIZE);
+  return (struct ring*)p;
+}
+
+// Issue n calls num(fd, buf, size) through the ring, batching
+// as many as fit.  Returns the number that did not return size.
+int
+batch(struct ring *r, int num, int fd, int size, int n)
+{
+  struct sqe *e;
+  int bad;
+
+  bad = 0;
+  while(n > 0 || r->cqhead != r->cqtail){
+    while(n > 0 && r->sqtail - r->sqhead < NRING){
+      e = &r->sq[r->sqtail % NRING];
+      e->num = num;
+      e->arg[0] = fd;
+      e->arg[1] = (int)buf;
+      e->arg[2] = size;
+      e->udata = n--;
+      r->sqtail++;
+    }
+    ring_enter(0);
+    for(; r->cqhead != r->cqtail; r->cqhead++)
+      if(r->cq[r->cqhead % NRING].ret != size)
+        bad++;
+  }
+  return bad;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct ring *r;
+  int fd, i, n, size, bad;
+  uint64 t0;
+  uint tw, tr;
+
+  n = argc > 1 ? atoi(argv[1]) : 1024;
+  size = argc > 2 ? atoi(argv[2]) : 16;
+  if(size > sizeof(buf))
+    size = sizeof(buf);
+
+  if((r = ringalloc()) == 0 || ring_setup(r) < 0){
+    printf(2, "ringbench: ring_setup failed\n");
+    exit();
+  }
+
+  fd = open("ringbench.tmp", O_CREATE | O_RDWR);
+  t0 = rdtsc();
+  for(i = 0; i < n; i++)
+    write(fd, buf, size);
+  tw = (rdtsc() - t0) >> 10;
+  close(fd);
+  fd = open("ringbench.tmp", O_RDONLY);
+  t0 = rdtsc();
+  for(i = 0; i < n; i++)
+    read(fd, buf, size);
+  tr = (rdtsc() - t0) >> 10;
+  close(fd);
+  printf(1, "trap per call: write %d kcycles, read %d kcycles\n", tw, tr);
+
+  fd = open("ringbench.tmp", O_CREATE | O_RDWR);
+  t0 = rdtsc();
+  bad = batch(r, SYS_write, fd, size, n);
+  tw = (rdtsc() - t0) >> 10;
+  close(fd);
+  fd = open("ringbench.tmp", O_RDONLY);
+  t0 = rdtsc();
+  bad += batch(r, SYS_read, fd, size, n);
+  tr = (rdtsc() - t0) >> 10;
+  close(fd);
+  printf(1, "ring batches:  write %d kcycles, read %d kcycles\n", tw, tr);
+  if(bad)
+    printf(1, "ringbench: %d short or failed calls\n", bad);
+
+  unlink("ringbench.tmp");
+  exit();
+}
@@ -52,6 +52,8 @@ struct backcmd {
 int fork1(void);  // Fork but panics on failure.
 void panic(char*);
 struct cmd *parsecmd(char*);
+void freecmd(struct cmd*);
+int parseerr;  // set by syntax() during parsecmd
 
 // Execute cmd.  Never returns.
 void
@@ -130,6 +132,75 @@ runcmd(struct cmd *cmd)
   exit();
 }
 
+// Can cmd run with spawn() alone?  True for simple commands,
+// possibly redirected, and pipelines of them.
+int
+spawnable(struct cmd *cmd)
+{
+  struct redircmd *rcmd;
+  struct pipecmd *pcmd;
+
+  switch(cmd->type){
+  case EXEC:
+    return ((struct execcmd*)cmd)->argv[0] != 0;
+  case REDIR:
+    rcmd = (struct redircmd*)cmd;
+    return rcmd->fd < 3 && spawnable(rcmd->cmd);
+  case PIPE:
+    pcmd = (struct pipecmd*)cmd;
+    return spawnable(pcmd->left) && spawnable(pcmd->right);
+  }
+  return 0;
+}
+
+// Start the spawnable cmd with fds[0..2] as its standard fds.
+// Returns the number of children started.
+int
+spawncmd(struct cmd *cmd, int *fds)
+{
+  int p[2], cfds[3], fd, n;
+  struct execcmd *ecmd;
+  struct pipecmd *pcmd;
+  struct redircmd *rcmd;
+
+  memmove(cfds, fds, sizeof(cfds));
+  switch(cmd->type){
+  case EXEC:
+    ecmd = (struct execcmd*)cmd;
+    if(spawn(ecmd->argv[0], ecmd->argv, cfds, 3) < 0){
+      printf(2, "exec %s failed\n", ecmd->argv[0]);
+      return 0;
+    }
+    return 1;
+
+  case REDIR:
+    rcmd = (struct redircmd*)cmd;
+    if((fd = open(rcmd->file, rcmd->mode)) < 0){
+      printf(2, "open %s failed\n", rcmd->file);
+      return 0;
+    }
+    cfds[rcmd->fd] = fd;
+    n = spawncmd(rcmd->cmd, cfds);
+    close(fd);
+    return n;
+
+  case PIPE:
+    pcmd = (struct pipecmd*)cmd;
+    if(pipe(p) < 0)
+      panic("pipe");
+    cfds[1] = p[1];
+    n = spawncmd(pcmd->left, cfds);
+    cfds[0] = p[0];
+    cfds[1] = fds[1];
+    n += spawncmd(pcmd->right, cfds);
+    close(p[0]);
+    close(p[1]);
+    return n;
+  }
+  panic("spawncmd");
+  return 0;
+}
+
 int
 getcmd(char *buf, int nbuf)
 {
@@ -145,7 +216,9 @@ int
 main(void)
 {
   static char buf[100];
-  int fd;
+  static int stdfds[3] = { 0, 1, 2 };
+  int fd, n;
+  struct cmd *cmd;
 
   // Ensure that three file descriptors are open.
   while((fd = open("console", O_RDWR)) >= 0){
@@ -164,9 +237,22 @@ main(void)
         printf(2, "cannot cd %s\n", buf+3);
       continue;
     }
-    if(fork1() == 0)
-      runcmd(parsecmd(buf));
-    wait();
+    // Simple commands and pipelines are started with spawn(),
+    // which does not copy the shell; the rest need fork.
+    cmd = parsecmd(buf);
+    if(parseerr){
+      freecmd(cmd);
+      continue;
+    }
+    if(cmd && spawnable(cmd)){
+      for(n = spawncmd(cmd, stdfds); n > 0; n--)
+        wait();
+    } else {
+      if(fork1() == 0)
+        runcmd(cmd);
+      wait();
+    }
+    freecmd(cmd);
   }
   exit();
 }
@@ -324,20 +410,31 @@ struct cmd *parsepipe(char**, char*);
 struct cmd *parseexec(char**, char*);
 struct cmd *nulterminate(struct cmd*);
 
+// The shell itself parses each line, so a syntax error must
+// not exit: report it and let main skip the command.
+void
+syntax(char *msg)
+{
+  printf(2, "%s\n", msg);
+  parseerr = 1;
+}
+
 struct cmd*
 parsecmd(char *s)
 {
   char *es;
   struct cmd *cmd;
 
+  parseerr = 0;
   es = s + strlen(s);
   cmd = parseline(&s, es);
   peek(&s, es, "");
-  if(s != es){
+  if(s != es && !parseerr){
     printf(2, "leftovers: %s\n", s);
-    panic("syntax");
+    syntax("syntax");
   }
-  nulterminate(cmd);
+  if(!parseerr)
+    nulterminate(cmd);
   return cmd;
 }
 
@@ -379,8 +476,10 @@ parseredirs(struct cmd *cmd, char **ps, char *es)
 
   while(peek(ps, es, "<>")){
     tok = gettoken(ps, es, 0, 0);
-    if(gettoken(ps, es, &q, &eq) != 'a')
-      panic("missing file for redirection");
+    if(gettoken(ps, es, &q, &eq) != 'a'){
+      syntax("missing file for redirection");
+      break;
+    }
     switch(tok){
     case '<':
       cmd = redircmd(cmd, q, eq, O_RDONLY, 0);
@@ -405,8 +504,10 @@ parseblock(char **ps, char *es)
     panic("parseblock");
   gettoken(ps, es, 0, 0);
   cmd = parseline(ps, es);
-  if(!peek(ps, es, ")"))
-    panic("syntax - missing )");
+  if(!peek(ps, es, ")")){
+    syntax("syntax - missing )");
+    return cmd;
+  }
   gettoken(ps, es, 0, 0);
   cmd = parseredirs(cmd, ps, es);
   return cmd;
@@ -431,13 +532,17 @@ parseexec(char **ps, char *es)
   while(!peek(ps, es, "|)&;")){
     if((tok=gettoken(ps, es, &q, &eq)) == 0)
       break;
-    if(tok != 'a')
-      panic("syntax");
+    if(tok != 'a'){
+      syntax("syntax");
+      break;
+    }
+    if(argc >= MAXARGS-1){
+      syntax("too many args");
+      break;
+    }
     cmd->argv[argc] = q;
     cmd->eargv[argc] = eq;
     argc++;
-    if(argc >= MAXARGS)
-      panic("too many args");
     ret = parseredirs(ret, ps, es);
   }
   cmd->argv[argc] = 0;
@@ -491,3 +596,38 @@ nulterminate(struct cmd *cmd)
   }
   return cmd;
 }
+
+// Free a command tree made by parsecmd.  The strings
+// point into the input buffer and are not freed.
+void
+freecmd(struct cmd *cmd)
+{
+  struct backcmd *bcmd;
+  struct listcmd *lcmd;
+  struct pipecmd *pcmd;
+  struct redircmd *rcmd;
+
+  if(cmd == 0)
+    return;
+  switch(cmd->type){
+  case REDIR:
+    rcmd = (struct redircmd*)cmd;
+    freecmd(rcmd->cmd);
+    break;
+  case LIST:
+    lcmd = (struct listcmd*)cmd;
+    freecmd(lcmd->left);
+    freecmd(lcmd->right);
+    break;
+  case PIPE:
+    pcmd = (struct pipecmd*)cmd;
+    freecmd(pcmd->left);
+    freecmd(pcmd->right);
+    break;
+  case BACK:
+    bcmd = (struct backcmd*)cmd;
+    freecmd(bcmd->cmd);
+    break;
+  }
+  free(cmd);
+}
@@ -1,173 +1,324 @@
+// Shared memory segments.
+//
+// A segment is an object allocated by shmopen(), found by id
+// through a hash table, and freed when its last reference is
+// closed.  Its memory comes from kalloc_pages() in the largest
+// buddy blocks that are free, split into single pages (see
+// ksplit) so that each one can be mapped and reference counted
+// on its own; the segment keeps the list of them.  Every mapping
+// holds a page reference as well, dropped by freevm(), so freeing
+// a segment never pulls memory out from under a process that
+// still has it mapped.
+//
+// The opener holds one reference, and each shmattach() one more,
+// recorded in the segment's list of attachments.  A process that
+// exits gives up the references it still holds (see shmexit), so
+// a segment never outlives the processes using it, and a later
+// process with the same pid cannot inherit them.  The pages are
+// charged to the opener's memory group (see oom.c).
+
 #include "types.h"
 #include "defs.h"
 #include "param.h"
-#include "date.h"
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
-#include "x86.h"
-#include "traps.h"
+#include "memstat.h"
 #include "spinlock.h"
 
-#define MAXSHMPBLOCK   4  // maximum amount of pages in shared memory block
-#define MAXSHM         10 // maximum amount of shared memory blocks in OS
-#define PROCNUM        64 // maximum number of processes
+#define NSHMHASH     64
+#define SHMHASH(id)  ((uint)(id) % NSHMHASH)
+#define MAXSHMPAGES  (64*1024*1024 / PGSIZE)   // 64MB a segment
 
-struct shmblock
-{
-    int id;
-    int owner;
-    int flags;
-    int ref_count;
-    int size;
-    char* pages[MAXSHMPBLOCK];
-    int members[PROCNUM];
+struct shmattach {
+  int pid;
+  struct shmattach *next;
+};
+
+struct shmseg {
+  int id;
+  int owner;                  // pid that opened it, 0 once it exits
+  int flags;                  // 0: only the owner may write; else its children too
+  int open;                   // the opener has not closed it yet
+  int ref;                    // open plus attachments
+  int order;                  // kalloc_pages() order of this object
+  struct memgrp *grp;         // memory group charged for the pages
+  struct shmattach *attached;
+  struct shmseg *next;        // hash chain
+  uint npages;
+  char *pages[];
 };
 
 struct {
-    struct spinlock shmlock;
-    struct shmblock blocks[MAXSHM];
-} shmtable;
+  struct spinlock lock;
+  struct shmseg *hash[NSHMHASH];
+  struct shmattach *freeatt;  // unused attachment records
+} shm;
 
-int start = 1;
+void
+shminit(void)
+{
+  initlock(&shm.lock, "shm");
+}
 
-void shminit(void)
+// Find segment id.  Caller holds shm.lock.
+static struct shmseg*
+shmlookup(int id)
 {
-    int i,j;
-    initlock(&shmtable.shmlock,"shmtable");
-    cprintf("dd\n");
-    for(i = 0; i < MAXSHM; i++) {
-	shmtable.blocks[i].size = 0;
-  	shmtable.blocks[i].ref_count = 0;
-    for(j = 0; j < MAXSHMPBLOCK ; j++)
-        shmtable.blocks[i].pages[j] = 0;
-    for(j = 0; j < PROCNUM ; j++)
-        shmtable.blocks[i].members[j] = 0;
-    }
-    // cprintf("dd\n");
+  struct shmseg *s;
+
+  for(s = shm.hash[SHMHASH(id)]; s; s = s->next)
+    if(s->id == id)
+      return s;
+  return 0;
 }
 
-int shmopen(int id, int page_count, int flag)
+// Attachment records are carved out of whole pages, which are
+// never given back.  Caller holds shm.lock.
+static struct shmattach*
+attalloc(void)
 {
-    int i, j;
-    if(start){
-        shminit();
-        start=0;
+  struct shmattach *a;
+  char *pg;
+
+  if(shm.freeatt == 0){
+    if((pg = kalloc(KM_SHM)) == 0)
+      return 0;
+    for(a = (struct shmattach*)pg; a + 1 <= (struct shmattach*)(pg + PGSIZE); a++){
+      a->next = shm.freeatt;
+      shm.freeatt = a;
     }
+  }
+  a = shm.freeatt;
+  shm.freeatt = a->next;
+  return a;
+}
 
-    for(i = 0; i < MAXSHM; i++)
-        if (shmtable.blocks[i].id == id)
-            break;
-
-    if (i == MAXSHM) {
-        acquire(&shmtable.shmlock);
-        for(i = 0; i < MAXSHM; i++) {
-            if (shmtable.blocks[i].ref_count == 0) {
-                // cprintf("dud\n");// TODO : check page_count <= MAXSHMPBLOCK TEST
-                
-                if (page_count > MAXSHMPBLOCK)
-                    panic("Number of pages is larger than available blocks!:D");
-                
-                for(j = 0; j < page_count; j++) {
-                    shmtable.blocks[i].pages[j] = (char*)kalloc();
-                }
-
-		        // cprintf("dod\n");
-                shmtable.blocks[i].id = id;
-                shmtable.blocks[i].owner = myproc()->pid;
-                shmtable.blocks[i].flags = flag;
-                shmtable.blocks[i].ref_count = 1;
-                shmtable.blocks[i].size = page_count;
-                release(&shmtable.shmlock);
-                return 0;
-            }  
-        }
-        release(&shmtable.shmlock);
-        cprintf("shared mem is full!!");
-        return -3;
-    } else {
-        //release(&shmtable.shmlock);
-        cprintf("Shared mem is already open!!");
-        return -1;
+// Fill pages[0..n) with zeroed pages, taking them from the
+// largest buddy blocks that are free.
+static int
+shmfill(char **pages, uint n)
+{
+  uint i, j;
+  int order;
+  char *b;
+
+  order = MAXORDER;
+  for(i = 0; i < n; ){
+    while((1 << order) > n - i)
+      order--;
+    if(order == 0)
+      b = kalloc_zeroed(KM_SHM);
+    else if((b = kalloc_pages(order, KM_SHM)) != 0){
+      memset(b, 0, PGSIZE << order);
+      ksplit(b, order);
     }
+    if(b == 0){
+      if(order == 0)
+        goto bad;
+      order--;
+      continue;
+    }
+    for(j = 0; j < (1 << order); j++)
+      pages[i++] = b + j*PGSIZE;
+  }
+  return 0;
+
+ bad:
+  while(i > 0)
+    kfree(pages[--i]);
+  return -1;
 }
 
-void* shmattach(int id) {
-    int i, start_va = 0;
-    for(i = 0; i < MAXSHM; i++) {
-        if (shmtable.blocks[i].id == id) {
-            if(shmtable.blocks[i].flags == 0) {
-                if (myproc()->pid == shmtable.blocks[i].owner)
-                {
-                    acquire(&shmtable.shmlock);
-                    if ((start_va = shm_allocuvm(myproc()->pgdir, shmtable.blocks[i].pages, shmtable.blocks[i].size,
-                            PTE_W|PTE_U)) == 0)
-                    {
-                        cprintf("did\n");
-                        release(&shmtable.shmlock);
-                        panic("bad shared mem allocation!!");
-                    }
-                    release(&shmtable.shmlock);
-                } else {
-                    acquire(&shmtable.shmlock);
-                    if ((start_va = shm_allocuvm(myproc()->pgdir, shmtable.blocks[i].pages, shmtable.blocks[i].size,
-                            PTE_U)) == 0)
-                    {
-                        cprintf("did\n");
-                        release(&shmtable.shmlock);
-                        panic("bad shared mem allocation!!");
-                    }
-                    release(&shmtable.shmlock);
-                }
-            } else {
-                if (myproc()->pid == shmtable.blocks[i].owner || myproc()->parent->pid == shmtable.blocks[i].owner)
-                {
-                    acquire(&shmtable.shmlock);
-                    if ((start_va = shm_allocuvm(myproc()->pgdir, shmtable.blocks[i].pages, shmtable.blocks[i].size,
-                            PTE_W|PTE_U)) == 0)
-                    {
-                        cprintf("did\n");
-                        release(&shmtable.shmlock);
-                        panic("bad shared mem allocation!!");
-                    }
-                    release(&shmtable.shmlock);
-                }
-                else{
-                    release(&shmtable.shmlock);
-                    panic("Access denied!!");
-                }
-            }
-            acquire(&shmtable.shmlock);
-            shmtable.blocks[i].members[shmtable.blocks[i].ref_count-1] = myproc()->pid;
-            shmtable.blocks[i].ref_count++;
-            release(&shmtable.shmlock);
-            return (char*)start_va;
-        }
-    } 
-    return 0;  
+static void
+shmfree(struct shmseg *s)
+{
+  uint i;
+
+  for(i = 0; i < s->npages; i++)
+    kfree(s->pages[i]);
+  memuncharge(s->grp, s->npages);
+  kfree_pages((char*)s, s->order);
+}
+
+// Create segment id of page_count pages.  Returns 0, or -1 if
+// it exists, -2 if memory is short, -4 if that is over the
+// memory group's limit, or -5 for a bad size.
+int
+shmopen(int id, int page_count, int flag)
+{
+  struct shmseg *s;
+  struct memgrp *g;
+  int order;
+
+  if(page_count <= 0 || page_count > MAXSHMPAGES)
+    return -5;
+  for(order = 0; (PGSIZE << order) < sizeof(*s) + page_count*sizeof(char*); order++)
+    ;
+
+  acquire(&shm.lock);
+  s = shmlookup(id);
+  release(&shm.lock);
+  if(s)
+    return -1;
+  if((g = memcharge(myproc(), page_count)) == 0)
+    return -4;
+  if((s = (struct shmseg*)kalloc_pages(order, KM_SHM)) == 0){
+    memuncharge(g, page_count);
+    return -2;
+  }
+  s->npages = page_count;
+  s->order = order;
+  s->grp = g;
+  if(shmfill(s->pages, s->npages) < 0){
+    kfree_pages((char*)s, order);
+    memuncharge(g, page_count);
+    return -2;
+  }
+  s->id = id;
+  s->owner = myproc()->pid;
+  s->flags = flag;
+  s->open = 1;
+  s->ref = 1;
+  s->attached = 0;
+
+  // Filling it took a while; someone may have beaten us to id.
+  acquire(&shm.lock);
+  if(shmlookup(id)){
+    release(&shm.lock);
+    shmfree(s);
+    return -1;
+  }
+  s->next = shm.hash[SHMHASH(id)];
+  shm.hash[SHMHASH(id)] = s;
+  release(&shm.lock);
+  return 0;
+}
+
+// Map segment id into the current process.  Returns its address,
+// or 0 if there is no such segment, the process may not attach
+// it, or there is no room.
+void*
+shmattach(int id)
+{
+  struct proc *p = myproc();
+  struct shmseg *s;
+  struct shmattach *a;
+  int perm;
+  uint va;
+
+  acquire(&shm.lock);
+  if((s = shmlookup(id)) == 0)
+    goto bad;
+  if(s->flags == 0)
+    perm = p->pid == s->owner ? PTE_W|PTE_U : PTE_U;
+  else if(p->pid == s->owner || (p->parent && p->parent->pid == s->owner))
+    perm = PTE_W|PTE_U;
+  else
+    goto bad;
+  if((a = attalloc()) == 0)
+    goto bad;
+  if((va = shm_allocuvm(p->pgdir, s->pages, s->npages, perm)) == 0){
+    a->next = shm.freeatt;
+    shm.freeatt = a;
+    goto bad;
+  }
+  a->pid = p->pid;
+  a->next = s->attached;
+  s->attached = a;
+  s->ref++;
+  release(&shm.lock);
+  return (void*)va;
+
+ bad:
+  release(&shm.lock);
+  return 0;
+}
+
+// Drop the current process's reference to segment id: one of
+// its attachments, or else the opener's.  The segment goes away
+// with the last one; mappings keep their pages until they go.
+int
+shmclose(int id)
+{
+  struct proc *p = myproc();
+  struct shmseg *s, **sp;
+  struct shmattach *a, **ap;
+
+  acquire(&shm.lock);
+  for(sp = &shm.hash[SHMHASH(id)]; (s = *sp) != 0; sp = &s->next)
+    if(s->id == id)
+      break;
+  if(s == 0)
+    goto bad;
+  for(ap = &s->attached; (a = *ap) != 0; ap = &a->next)
+    if(a->pid == p->pid)
+      break;
+  if(a){
+    *ap = a->next;
+    a->next = shm.freeatt;
+    shm.freeatt = a;
+  } else if(p->pid == s->owner && s->open)
+    s->open = 0;
+  else
+    goto bad;
+  if(--s->ref > 0){
+    release(&shm.lock);
+    return 0;
+  }
+  *sp = s->next;
+  release(&shm.lock);
+  shmfree(s);
+  return 0;
+
+ bad:
+  release(&shm.lock);
+  return -1;
 }
 
-int shmclose(int id)
-{ 
-    int i, j, k;
-    for(i = 0; i < MAXSHM; i++) {
-        if (shmtable.blocks[i].id == id) {
-            acquire(&shmtable.shmlock);
-            for(j = 0; j < PROCNUM ; j++){
-                if (myproc()->pid == shmtable.blocks[i].owner || myproc()->pid == shmtable.blocks[i].members[j]){
-                    shmtable.blocks[i].ref_count--;
-                    if (shmtable.blocks[i].ref_count == 0)
-                    {
-                        for (k = 0; k < shmtable.blocks[i].size; ++k)
-                        {
-                            kfree(shmtable.blocks[i].pages[k]);
-                        }
-                    }
-                    break;
-                }
-            }
-            release(&shmtable.shmlock);
+// p is exiting: drop its attachments and, for a segment it
+// opened and has not closed, the opener's reference.
+void
+shmexit(struct proc *p)
+{
+  struct shmseg *s, **sp, *dead;
+  struct shmattach *a, **ap;
+  int i;
+
+  dead = 0;
+  acquire(&shm.lock);
+  for(i = 0; i < NSHMHASH; i++){
+    for(sp = &shm.hash[i]; (s = *sp) != 0; ){
+      for(ap = &s->attached; (a = *ap) != 0; ){
+        if(a->pid != p->pid){
+          ap = &a->next;
+          continue;
+        }
+        *ap = a->next;
+        a->next = shm.freeatt;
+        shm.freeatt = a;
+        s->ref--;
+      }
+      if(s->owner == p->pid){
+        if(s->open){
+          s->open = 0;
+          s->ref--;
         }
+        s->owner = 0;
+      }
+      if(s->ref > 0){
+        sp = &s->next;
+        continue;
+      }
+      *sp = s->next;
+      s->next = dead;
+      dead = s;
     }
-    return 0;
+  }
+  release(&shm.lock);
+
+  while((s = dead) != 0){
+    dead = s->next;
+    shmfree(s);
+  }
 }
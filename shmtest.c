@@ -0,0 +1,95 @@
+// shmtest: check large and numerous shared memory segments.
+// Usage: shmtest
+
+#include "types.h"
+#include "param.h"
+#include "stat.h"
+#include "user.h"
+#include "memstat.h"
+
+#define PG     4096
+#define BIG    1024     // pages: 4MB
+#define MANY   40
+
+struct memstat ms;
+
+void
+fail(char *msg)
+{
+  printf(1, "shmtest: FAIL %s\n", msg);
+  exit();
+}
+
+// Page table pages of this process, from memstat.
+int
+pgtbls(void)
+{
+  int i, pid;
+
+  pid = getpid();
+  if(memstat(&ms) < 0)
+    return -1;
+  for(i = 0; i < ms.nproc; i++)
+    if(ms.proc[i].pid == pid)
+      return ms.proc[i].pgtbl;
+  return -1;
+}
+
+int
+main(void)
+{
+  char *a;
+  int i, n;
+
+  if(shm_open(5000, 0, 0) == 0)
+    fail("empty segment");
+  if(shm_open(5000, 1 << 20, 0) == 0)
+    fail("4GB segment");
+
+  // A child fills a 4MB segment; the parent reads it back.
+  if(shm_open(5001, BIG, 1) != 0)
+    fail("shm_open 4MB");
+  if(shm_open(5001, 1, 0) != -1)
+    fail("shm_open of an open id");
+  if(fork() == 0){
+    if((a = shm_attach(5001)) == 0)
+      fail("child shm_attach");
+    for(i = 0; i < BIG; i++)
+      a[i*PG] = i;
+    shm_close(5001);
+    exit();
+  }
+  wait();
+  // A fresh 4MB segment is one buddy block: it should be mapped
+  // by a single superpage, with no page table.
+  n = pgtbls();
+  if((a = shm_attach(5001)) == 0)
+    fail("parent shm_attach");
+  if((uint)a % (BIG*PG) != 0 || pgtbls() != n)
+    fail("4MB segment not in a superpage");
+  for(i = 0; i < BIG; i++)
+    if(a[i*PG] != (char)i)
+      fail("child's writes missing");
+
+  // Segments go in high, leaving the heap room to grow.
+  if(a < sbrk(0) + BIG*PG || sbrk(BIG*PG) == (char*)-1)
+    fail("segment in the heap's way");
+  sbrk(-BIG*PG);
+  if(shm_close(5001) < 0 || shm_close(5001) < 0)
+    fail("shm_close");
+  if(shm_close(5001) != -1)
+    fail("shm_close of a closed id");
+  if(shm_open(5001, 1, 0) != 0 || shm_close(5001) < 0)
+    fail("reopen after close");
+
+  // More segments than the old fixed table held.
+  for(i = 0; i < MANY; i++)
+    if(shm_open(6000 + i, 2, 0) != 0)
+      fail("shm_open of many");
+  for(i = 0; i < MANY; i++)
+    if(shm_close(6000 + i) < 0)
+      fail("shm_close of many");
+
+  printf(1, "shmtest: ok\n");
+  exit();
+}
@@ -0,0 +1,64 @@
+// spawnbench: compare fork+exec with spawn.
+// Usage: spawnbench [n] [heap KB]
+// Starts n short-lived children each way from a parent whose
+// heap has been grown and touched, like a long-running shell.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "x86.h"
+
+#define PGSIZE 4096
+
+char *childargv[] = { "spawnbench", "-x", 0 };
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, kb, pid;
+  int fds[3] = { 0, 1, 2 };
+  char *heap;
+  uint64 t0;
+  uint tfork, tspawn;
+
+  if(argc > 1 && strcmp(argv[1], "-x") == 0)
+    exit();
+  n = argc > 1 ? atoi(argv[1]) : 32;
+  kb = argc > 2 ? atoi(argv[2]) : 256;
+  if(n < 1)
+    n = 1;
+
+  if((heap = sbrk(kb*1024)) == (char*)-1){
+    printf(2, "spawnbench: out of memory\n");
+    exit();
+  }
+  for(i = 0; i < kb*1024; i += PGSIZE)
+    heap[i] = 1;
+
+  t0 = rdtsc();
+  for(i = 0; i < n; i++){
+    if((pid = fork()) == 0){
+      exec(childargv[0], childargv);
+      printf(2, "spawnbench: exec failed\n");
+      exit();
+    }
+    if(pid < 0)
+      break;
+    wait();
+  }
+  tfork = (rdtsc() - t0) >> 10;
+
+  t0 = rdtsc();
+  for(i = 0; i < n; i++){
+    if(spawn(childargv[0], childargv, fds, 3) < 0){
+      printf(2, "spawnbench: spawn failed\n");
+      break;
+    }
+    wait();
+  }
+  tspawn = (rdtsc() - t0) >> 10;
+
+  printf(1, "%d KB heap: fork+exec %d kcycles, spawn %d kcycles per child\n",
+         kb, tfork / n, tspawn / n);
+  exit();
+}
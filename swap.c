@@ -0,0 +1,274 @@
+// Swap: paging user memory out to the swap disk (SWAPDEV).
+//
+// The page-out daemon, kswapd, wakes every tick and, while free
+// memory is below SWAPLOW pages, pages out until SWAPHIGH pages
+// are free again.  It picks pages with the clock algorithm,
+// sweeping over the page tables of all processes: a page whose
+// accessed bit is set has it cleared and gets a second chance;
+// one found with the bit still clear is written to a swap slot,
+// and its PTE becomes a swap entry, PTE_SWAP with the slot
+// number where the physical address was.  pagefault() reads the
+// page back on the next touch.
+//
+// Only private pages (kalloc reference count 1) of processes
+// that are neither running nor inside a system call are paged
+// out.  So nobody else maps the page, no CPU has it in its TLB,
+// and the kernel is not using it as a system call buffer,
+// maybe with a spinlock held.  Slots are reference counted so
+// that fork can share a paged-out page between parent and child.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+#include "memstat.h"
+
+#define SWAPSCAN  4096  // pages kswapd looks at per page-out, at most
+#define SWAPTRIES   10  // ticks a fault waits for kswapd to free memory
+#define SWAPMIN     16  // pages kswapd frees at least for a waiting fault
+
+struct {
+  struct spinlock lock;
+  int enabled;
+  uchar ref[NSWAP];      // references to each slot
+  uchar busy[NSWAP];     // slot is being written
+  uint nused;            // slots with references
+  uint next;             // where to look for a free slot
+  int hproc;             // clock hand: process table slot ...
+  uint hva;              // ... and user address in it
+  uint pageins;
+  uint pageouts;
+  uint scans;            // pages the clock hand passed
+  uint refs;             // second chances given
+  uint waits;            // faults that waited for kswapd
+  int wanted;            // a fault is waiting for memory
+  struct sleeplock iolock;  // protects iobuf
+  struct buf iobuf[PGSIZE/BSIZE];
+} swap;
+
+// Allocate a slot with one reference, or return -1.
+static int
+slotalloc(void)
+{
+  int i, s;
+
+  acquire(&swap.lock);
+  for(i = 0; i < NSWAP; i++){
+    s = (swap.next + i) % NSWAP;
+    if(swap.ref[s] == 0 && !swap.busy[s]){
+      swap.ref[s] = 1;
+      swap.nused++;
+      swap.next = s + 1;
+      release(&swap.lock);
+      return s;
+    }
+  }
+  release(&swap.lock);
+  return -1;
+}
+
+// Another page table refers to slot s.
+void
+swapdup(uint s)
+{
+  acquire(&swap.lock);
+  if(swap.ref[s] == 0 || swap.ref[s] == 255)
+    panic("swapdup");
+  swap.ref[s]++;
+  release(&swap.lock);
+}
+
+// Drop a reference to slot s.
+void
+swapput(uint s)
+{
+  acquire(&swap.lock);
+  if(swap.ref[s] == 0)
+    panic("swapput");
+  if(--swap.ref[s] == 0)
+    swap.nused--;
+  release(&swap.lock);
+}
+
+// Move one page between memory and slot s.
+static void
+swapio(char *page, uint s, int write)
+{
+  struct buf *b;
+  int i;
+
+  acquiresleep(&swap.iolock);
+  for(i = 0; i < PGSIZE/BSIZE; i++){
+    b = &swap.iobuf[i];
+    acquiresleep(&b->lock);
+    b->dev = SWAPDEV;
+    b->blockno = s*(PGSIZE/BSIZE) + i;
+    if(write){
+      memmove(b->data, page + i*BSIZE, BSIZE);
+      b->flags = B_DIRTY;
+    } else
+      b->flags = 0;
+    iderw(b);
+    if(!write)
+      memmove(page + i*BSIZE, b->data, BSIZE);
+    releasesleep(&b->lock);
+  }
+  releasesleep(&swap.iolock);
+}
+
+// Read slot s into page, once any write of it is done.
+void
+swapread(char *page, uint s)
+{
+  acquire(&swap.lock);
+  while(swap.busy[s])
+    sleep(&swap.busy[s], &swap.lock);
+  release(&swap.lock);
+  swapio(page, s, 0);
+  acquire(&swap.lock);
+  swap.pageins++;
+  release(&swap.lock);
+}
+
+static int
+swappable(struct proc *p)
+{
+  return (p->state == RUNNABLE || p->state == SLEEPING) &&
+         !p->insyscall && p->sz > 0 && p->pgdir;
+}
+
+// Page out one page.  Returns -1 if the clock hand found
+// nothing to page out or there is no free slot.
+static int
+swapout(void)
+{
+  struct proc *ptab, *p;
+  pte_t *pte;
+  uint pa;
+  int s, n;
+
+  if((s = slotalloc()) < 0)
+    return -1;
+  ptab = lockptable();
+  for(n = 0; n < SWAPSCAN; n++){
+    p = &ptab[swap.hproc];
+    if(swap.hva >= KERNBASE || !swappable(p)){
+      swap.hproc = (swap.hproc + 1) % NPROC;
+      swap.hva = 0;
+      continue;
+    }
+    if((pte = uvmpte(p->pgdir, swap.hva)) == 0){
+      swap.hva = PGADDR(PDX(swap.hva) + 1, 0, 0);
+      continue;
+    }
+    swap.hva += PGSIZE;
+    swap.scans++;
+    if((*pte & (PTE_P|PTE_U)) != (PTE_P|PTE_U))
+      continue;
+    if(*pte & PTE_A){
+      *pte &= ~PTE_A;
+      swap.refs++;
+      continue;
+    }
+    pa = PTE_ADDR(*pte);
+    if(krefcount(P2V(pa)) != 1)
+      continue;
+
+    // p is not running, so no TLB holds the old entry.
+    *pte = (s << PTXSHIFT) | (PTE_FLAGS(*pte) & ~(PTE_P|PTE_A|PTE_D)) | PTE_SWAP;
+    swap.busy[s] = 1;
+    unlockptable();
+
+    swapio(P2V(pa), s, 1);
+    kfree(P2V(pa));
+    acquire(&swap.lock);
+    swap.busy[s] = 0;
+    swap.pageouts++;
+    wakeup(&swap.busy[s]);
+    release(&swap.lock);
+    return 0;
+  }
+  unlockptable();
+  swapput(s);
+  return -1;
+}
+
+// The page-out daemon.  A fault that could not get memory asks
+// for some even if kfreecount() looks high enough.
+static void
+kswapd(void)
+{
+  int n, wanted;
+
+  for(;;){
+    acquire(&tickslock);
+    sleep(&ticks, &tickslock);
+    release(&tickslock);
+    acquire(&swap.lock);
+    wanted = swap.wanted;
+    swap.wanted = 0;
+    release(&swap.lock);
+    if(kfreecount() >= SWAPLOW && !wanted)
+      continue;
+    for(n = 0; kfreecount() < SWAPHIGH || (wanted && n < SWAPMIN); n++)
+      if(swapout() < 0)
+        break;
+  }
+}
+
+// A page fault could not get memory.  Wait a tick for kswapd
+// to free some and return 0 to have it retried, or -1 if that
+// would not help.  try counts the retries so far.  The failed
+// kalloc() itself says memory is short: kfreecount() also counts
+// pages cached on other CPUs, which kalloc() drains only as a
+// last resort.
+int
+swapwait(int try)
+{
+  if(!swap.enabled || try >= SWAPTRIES)
+    return -1;
+  acquire(&swap.lock);
+  swap.waits++;
+  swap.wanted = 1;
+  release(&swap.lock);
+  acquire(&tickslock);
+  sleep(&ticks, &tickslock);
+  release(&tickslock);
+  return 0;
+}
+
+// Fill in the swap part of a memstat.
+void
+swapstat(struct memstat *ms)
+{
+  acquire(&swap.lock);
+  ms->swaptotal = swap.enabled ? NSWAP : 0;
+  ms->swapused = swap.nused;
+  ms->pageins = swap.pageins;
+  ms->pageouts = swap.pageouts;
+  ms->scans = swap.scans;
+  ms->refs = swap.refs;
+  ms->swapwaits = swap.waits;
+  release(&swap.lock);
+}
+
+void
+swapinit(void)
+{
+  int i;
+
+  initlock(&swap.lock, "swap");
+  initsleeplock(&swap.iolock, "swapio");
+  for(i = 0; i < PGSIZE/BSIZE; i++)
+    initsleeplock(&swap.iobuf[i].lock, "swapbuf");
+  if(!idepresent(SWAPDEV))
+    return;
+  swap.enabled = 1;
+  kthread("kswapd", kswapd);
+}
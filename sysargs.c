@@ -0,0 +1,82 @@
+// System call argument descriptor table, kept alongside
+// syscall.h: every SYS_* number there needs an entry here.
+// Linked into the kernel and into the user-space trace tools.
+
+#include "types.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+#include "syscall.h"
+#include "sysargs.h"
+
+char *argtypenames[] = {
+[AT_INT]    "int",
+[AT_UINT]   "uint",
+[AT_SHORT]  "short",
+[AT_STR]    "char*",
+[AT_BUF]    "char*",
+[AT_INTP]   "int*",
+[AT_ARGV]   "char**",
+[AT_STAT]   "struct stat*",
+[AT_PTR]    "void*",
+};
+
+struct sysdesc sysdescs[] = {
+[SYS_fork]              { "fork", 0 },
+[SYS_exit]              { "exit", 0 },
+[SYS_wait]              { "wait", 0 },
+[SYS_pipe]              { "pipe", 1, { AT_INTP } },
+[SYS_read]              { "read", 3, { AT_INT, AT_BUF, AT_INT } },
+[SYS_kill]              { "kill", 1, { AT_INT } },
+[SYS_exec]              { "exec", 2, { AT_STR, AT_ARGV } },
+[SYS_fstat]             { "fstat", 2, { AT_INT, AT_STAT } },
+[SYS_chdir]             { "chdir", 1, { AT_STR } },
+[SYS_dup]               { "dup", 1, { AT_INT } },
+[SYS_getpid]            { "getpid", 0 },
+[SYS_sbrk]              { "sbrk", 1, { AT_INT } },
+[SYS_sleep]             { "sleep", 1, { AT_INT } },
+[SYS_uptime]            { "uptime", 0 },
+[SYS_open]              { "open", 2, { AT_STR, AT_INT } },
+[SYS_write]             { "write", 3, { AT_INT, AT_BUF, AT_INT } },
+[SYS_mknod]             { "mknod", 3, { AT_STR, AT_SHORT, AT_SHORT } },
+[SYS_unlink]            { "unlink", 1, { AT_STR } },
+[SYS_link]              { "link", 2, { AT_STR, AT_STR } },
+[SYS_mkdir]             { "mkdir", 1, { AT_STR } },
+[SYS_close]             { "close", 1, { AT_INT } },
+[SYS_inc_num]           { "inc_num", 1, { AT_INT } },
+[SYS_invoked_syscalls]  { "invoked_syscalls", 1, { AT_INT } },
+[SYS_get_count]         { "get_count", 2, { AT_INT, AT_INT } },
+[SYS_sort_syscalls]     { "sort_syscalls", 4, { AT_INT, AT_PTR, AT_INT, AT_INT } },
+[SYS_log_syscalls]      { "log_syscalls", 0 },
+[SYS_halt]              { "halt", 0 },
+[SYS_ticketlockinit]    { "ticketlockinit", 0 },
+[SYS_ticketlocktest]    { "ticketlocktest", 0 },
+[SYS_rwinit]            { "rwinit", 0 },
+[SYS_rwtest]            { "rwtest", 1, { AT_UINT } },
+[SYS_wrinit]            { "wrinit", 0 },
+[SYS_wrtest]            { "wrtest", 1, { AT_UINT } },
+[SYS_chtickets]         { "chtickets", 2, { AT_INT, AT_INT } },
+[SYS_chpr]              { "chpr", 2, { AT_INT, AT_INT } },
+[SYS_ps]                { "ps", 0 },
+[SYS_chmfq]             { "chmfq", 2, { AT_INT, AT_INT } },
+[SYS_shm_init]          { "shm_init", 0 },
+[SYS_shm_open]          { "shm_open", 3, { AT_INT, AT_INT, AT_INT } },
+[SYS_shm_attach]        { "shm_attach", 1, { AT_INT } },
+[SYS_shm_close]         { "shm_close", 1, { AT_INT } },
+[SYS_trace]             { "trace", 2, { AT_INT, AT_INT } },
+[SYS_ring_setup]        { "ring_setup", 1, { AT_PTR } },
+[SYS_ring_enter]        { "ring_enter", 1, { AT_INT } },
+[SYS_memstat]           { "memstat", 1, { AT_PTR } },
+[SYS_spawn]             { "spawn", 4, { AT_STR, AT_ARGV, AT_PTR, AT_INT } },
+[SYS_mmap]              { "mmap", 4, { AT_INT, AT_INT, AT_INT, AT_INT } },
+[SYS_munmap]            { "munmap", 2, { AT_PTR, AT_INT } },
+[SYS_superpages]        { "superpages", 1, { AT_INT } },
+[SYS_memlimit]          { "memlimit", 2, { AT_INT, AT_INT } },
+};
+
+int nsysdescs = sizeof(sysdescs)/sizeof(sysdescs[0]);
+
+// The build fails here if a system call is added without an
+// entry above, or SYS_CALL_COUNT is not raised to match.
+typedef char sysdescs_cover_syscalls
+  [sizeof(sysdescs)/sizeof(sysdescs[0]) == SYS_CALL_COUNT+1 ? 1 : -1];
@@ -0,0 +1,23 @@
+// System call argument descriptors (see sysargs.c).
+// The kernel uses them to capture arguments as raw values;
+// type names are only rendered when a record is decoded.
+
+#define AT_INT    1   // int
+#define AT_UINT   2   // uint
+#define AT_SHORT  3   // short
+#define AT_STR    4   // nul-terminated user string
+#define AT_BUF    5   // user buffer
+#define AT_INTP   6   // int array
+#define AT_ARGV   7   // string vector
+#define AT_STAT   8   // struct stat
+#define AT_PTR    9   // other user pointer
+
+struct sysdesc {
+  char *name;
+  int nargs;
+  uchar type[MAXSYSARGS];
+};
+
+extern char *argtypenames[];
+extern struct sysdesc sysdescs[];
+extern int nsysdescs;
@@ -8,9 +8,12 @@
 #include "x86.h"
 #include "syscall.h"
 #include "stat.h"
+#include "trace.h"
+#include "sysargs.h"
 
-struct node* first_proc;
-struct node* last_proc; 
+// System-wide syscall counters, kept per CPU so that
+// syscall() can update them without a shared lock.
+static struct sysstat cpustat[NCPU][SYS_CALL_COUNT+1];
 
 // User code makes a system call with INT T_SYSCALL.
 // System call number in %eax.
@@ -18,13 +21,34 @@ struct node* last_proc;
 // library system call function. The saved user %esp points
 // to a saved program counter, and then the first argument.
 
+// User memory that system calls read is brought in first (see
+// prefault), so that a fault on it cannot fail in the kernel.
+
+// System calls may use the memory of p below sz and in its file
+// mappings.  Return the end of the stretch holding addr, or 0 if
+// addr is in neither.
+static uint
+uvmend(struct proc *p, uint addr)
+{
+  struct vma *v;
+
+  if(addr < p->sz)
+    return p->sz;
+  if((v = vmaoverlap(p, addr, addr + 1)) != 0)
+    return v->end;
+  return 0;
+}
+
 // Fetch the int at addr from the current process.
 int
 fetchint(uint addr, int *ip)
 {
   struct proc *curproc = myproc();
+  uint end;
 
-  if(addr >= curproc->sz || addr+4 > curproc->sz)
+  if((end = uvmend(curproc, addr)) == 0 || addr+4 > end)
+    return -1;
+  if(prefault(curproc, addr, 4, 0) < 0)
     return -1;
   *ip = *(int*)(addr);
   return 0;
@@ -38,12 +62,16 @@ fetchstr(uint addr, char **pp)
 {
   char *s, *ep;
   struct proc *curproc = myproc();
+  uint end;
 
-  if(addr >= curproc->sz)
+  if((end = uvmend(curproc, addr)) == 0)
     return -1;
   *pp = (char*)addr;
-  ep = (char*)curproc->sz;
+  ep = (char*)end;
   for(s = *pp; s < ep; s++){
+    if((s == *pp || (uint)s % PGSIZE == 0) &&
+       prefault(curproc, (uint)s, 1, 0) < 0)
+      return -1;
     if(*s == 0)
       return s - *pp;
   }
@@ -57,23 +85,40 @@ argint(int n, int *ip)
   return fetchint((myproc()->tf->esp) + 4 + 4*n, ip);
 }
 
-// Fetch the nth word-sized system call argument as a pointer
-// to a block of memory of size bytes.  Check that the pointer
-// lies within the process address space.
-int
-argptr(int n, char **pp, int size)
+static int
+argbuf(int n, char **pp, int size, int write)
 {
   int i;
+  uint end;
   struct proc *curproc = myproc();
  
   if(argint(n, &i) < 0)
     return -1;
-  if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
+  if(size < 0 || (end = uvmend(curproc, i)) == 0 || (uint)i+size > end)
+    return -1;
+  if(prefault(curproc, i, size, write) < 0)
     return -1;
   *pp = (char*)i;
   return 0;
 }
 
+// Fetch the nth word-sized system call argument as a pointer
+// to a block of memory of size bytes.  Check that the pointer
+// lies within the process address space or one file mapping,
+// and bring the block in (see prefault).
+int
+argptr(int n, char **pp, int size)
+{
+  return argbuf(n, pp, size, 0);
+}
+
+// Like argptr, for a block the system call writes into.
+int
+argoutptr(int n, char **pp, int size)
+{
+  return argbuf(n, pp, size, 1);
+}
+
 // Fetch the nth word-sized system call argument as a string pointer.
 // Check that the pointer is valid and the string is nul-terminated.
 // (There is no shared writable memory, so the string can't change
@@ -128,50 +173,15 @@ extern int sys_shm_init(void);
 extern int sys_shm_open(void);
 extern int sys_shm_attach(void);
 extern int sys_shm_close(void);
-
-static char* syscalls_string [41] = {
-"sys_fork",
-"sys_exit",
-"sys_wait",
-"sys_pipe",
-"sys_read",
-"sys_kill",
-"sys_exec",
-"sys_fstat",
-"sys_chdir",
-"sys_dup",
-"sys_getpid",
-"sys_sbrk",
-"sys_sleep",
-"sys_uptime",
-"sys_open",
-"sys_write",
-"sys_mknod",
-"sys_unlink",
-"sys_link",
-"sys_mkdir",
-"sys_close",
-"sys_inc_num",
-"sys_invoked_syscalls",
-"sys_get_count",
-"sys_sort_syscalls",
-"sys_log_syscalls",
-"sys_halt",
-"sys_ticketlockinit",
-"sys_ticketlocktest",
-"sys_rwinit",
-"sys_rwtest",
-"sys_wrinit",
-"sys_wrtest",
-"sys_chtickets",
-"sys_chpr",
-"sys_ps",
-"sys_chmfq",
-"sys_shm_init",
-"sys_shm_open",
-"sys_shm_attach",
-"sys_shm_close"
-};
+extern int sys_trace(void);
+extern int sys_ring_setup(void);
+extern int sys_ring_enter(void);
+extern int sys_memstat(void);
+extern int sys_spawn(void);
+extern int sys_mmap(void);
+extern int sys_munmap(void);
+extern int sys_superpages(void);
+extern int sys_memlimit(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -214,160 +224,106 @@ static int (*syscalls[])(void) = {
 [SYS_shm_init]  sys_shm_init,
 [SYS_shm_open]  sys_shm_open,
 [SYS_shm_attach]  sys_shm_attach,
-[SYS_shm_close]  sys_shm_close
+[SYS_shm_close]  sys_shm_close,
+[SYS_trace]  sys_trace,
+[SYS_ring_setup]  sys_ring_setup,
+[SYS_ring_enter]  sys_ring_enter,
+[SYS_memstat]  sys_memstat,
+[SYS_spawn]  sys_spawn,
+[SYS_mmap]   sys_mmap,
+[SYS_munmap] sys_munmap,
+[SYS_superpages] sys_superpages,
+[SYS_memlimit]   sys_memlimit,
 };
 
-void fill_arglist(struct syscallarg* end, int type){
-	int int_arg,int_arg2;
-        int fd;
-        int n;
-        char *p;
-	int* fds;
-        char *path;
-        char *path1;
-        uint uargv;
-        struct stat *st;
-	switch(type){
-                case 3:
-                case 2:
-		case 1:
-                case 14:
-                case 11:
-                case 28:
-                case 29:
-                case 30:
-                case 32:
-                case 36:
-		case 38:
-			safestrcpy(end->type[0], "void", strlen("void")+1);break;
-		case 6:
-		case 22:
-                case 23:
-                case 25:
-                case 12:
-                case 13:
-                case 10:
-                case 21:
-                case 31:
-                case 33:
-		case 40:
-		case 41:
-			safestrcpy(end->type[0], "int", strlen("int")+1);
-			if (argint(0, &int_arg) < 0){
-   				cprintf("bad int arg val?\n");
-   				break;
-			}
-			end->int_argv[0] = int_arg;
-			break;
-                case 24:
-                case 34:
-                case 35:
-                case 37:
-                        safestrcpy(end->type[0], "int", strlen("int")+1);
-                        safestrcpy(end->type[1], "int", strlen("int")+1);
-			if (argint(0, &int_arg) < 0 || argint(1, &int_arg2) < 0){
-   				cprintf("bad int arg val?\n");
-   				break;
-			}
-			end->int_argv[0] = int_arg;
-                        end->int_argv[1] = int_arg2;
-			break;
-                case 4:
-                        safestrcpy(end->type[0], "int*", strlen("int*")+1);
-                        if (argptr(0, (void*)&fds, 2*sizeof(fds[0])) < 0){
-                                cprintf("bad int* arg val?\n");
-   				break;
-                        }
-                        end->intptr_argv = fds;
-                        break;
-                case 5:
-                case 16:
-                        safestrcpy(end->type[0], "int", strlen("int")+1);
-                        safestrcpy(end->type[1], "char*", strlen("char*")+1);
-                        safestrcpy(end->type[2], "int", strlen("int")+1);
-                        if(argint(0, &fd) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0){
-                                cprintf("bad 3 arg val?\n");
-   				break;
-                        }
-                        end->int_argv[0] = fd;
-                        end->int_argv[1] = n;
-                        end->str_argv[0] = p;
-                        break;
-                case 7:
-		        safestrcpy(end->type[0], "char*", strlen("char*")+1);
-                        safestrcpy(end->type[1], "char**", strlen("char**")+1);
-                        if(argstr(0, &path) < 0 || argint(1, (int*)&uargv) < 0){
-                               cprintf("bad exec arg val?\n");
-   			       break;
-                        }
-                        end->str_argv[0] = path;
-                        end->ptr_argv[0] = (char**)uargv;
-                        break;
-                case 15:
-                        safestrcpy(end->type[0], "char*", strlen("char*")+1);
-                        safestrcpy(end->type[1], "int", strlen("int")+1);
-                        if(argstr(0, &path) < 0 || argint(1, &n) < 0){
-                               cprintf("bad open arg val?\n");
-   			       break;
-                        }
-                        end->str_argv[0] = path;
-                        end->int_argv[0] = n;
-                        break;
-               case 18:
-               case 20:
-               case 9:
-                        safestrcpy(end->type[0], "char*", strlen("char*")+1);
-                        if(argstr(0, &path) < 0){
-                               cprintf("bad path arg val?\n");
-   			       break;
-                        }
-                        end->str_argv[0] = path;
-                        break;
-               case 19:
-                        safestrcpy(end->type[0], "char*", strlen("char*")+1);
-                        safestrcpy(end->type[1], "char*", strlen("char*")+1);
-                        if(argstr(0, &path) < 0 || argstr(0, &path1) < 0){
-                               cprintf("bad path arg val?\n");
-   			       break;
-                        }
-                        end->str_argv[0] = path;
-                        end->str_argv[1] = path1;
-                        break;
-               case 8:
-                        safestrcpy(end->type[0], "int", strlen("int")+1);
-                        safestrcpy(end->type[1], "struct stat*", strlen("struct stat*")+1);
-                        if(argint(0, &n) < 0 || argptr(1, (void*)&st, sizeof(*st)) < 0){
-                               cprintf("bad fstat arg val?\n");
-   			       break;
-                        }
-                        end->int_argv[0] = n;
-                        end->st = st;
-                        break;
-              case 17:
-                        safestrcpy(end->type[0], "char*", strlen("char*")+1);
-                        safestrcpy(end->type[1], "short", strlen("short")+1);
-                        safestrcpy(end->type[2], "short", strlen("short")+1);
-                        if(argstr(0, &path) < 0 || argint(1, &n) < 0 || argint(2, &fd) < 0){
-                               cprintf("bad mknode arg val?\n");
-   			       break;
-                        }
-                        end->int_argv[0] = n;
-                        end->int_argv[1] = fd;
-                        end->str_argv[0] = path;
-                        break;
-              case 39:
-			safestrcpy(end->type[0], "int", strlen("int")+1);
-                        safestrcpy(end->type[1], "int", strlen("int")+1);
-                        safestrcpy(end->type[2], "int", strlen("int")+1);
-                        if(argint(0, &int_arg) < 0 || argint(1, &n) < 0 || argint(2, &fd) < 0){
-                               cprintf("bad arg val?\n");
-   			       break;
-                        }
-                        end->int_argv[0] = int_arg;
-                        end->int_argv[1] = n;
-                        end->int_argv[2] = fd;
-                        break;
-	}
+static void getargs(struct proc*, int, int*, char*);
+
+// Run system call num with its arguments where tf->esp says,
+// tracing it and charging it to the process and this CPU.
+static int
+dosyscall(struct proc *curproc, int num)
+{
+  struct sysrec *r;
+  struct sysstat *st;
+  uint64 t0, dt;
+  int ret;
+
+  // Claim the history slot first: a batched call made from
+  // inside ring_enter takes the next one.
+  r = &curproc->syshist[curproc->nsyshist++ % NSYSHIST];
+  r->num = num;
+  getargs(curproc, num, r->argv, r->str);
+  t0 = rdtsc();
+  ret = syscalls[num]();
+  dt = rdtsc() - t0;
+  tracelog(curproc->pid, num, ret, r->argv, r->str, curproc->traceflags);
+  r->ticks = ticks;
+  st = &curproc->sysstat[num];
+  st->count++;
+  st->last = ticks;
+  st->cycles += dt;
+  pushcli();
+  st = &cpustat[cpuid()][num];
+  st->count++;
+  st->last = ticks;
+  st->cycles += dt;
+  popcli();
+  return ret;
+}
+
+// Capture the arguments of system call num as raw values,
+// as described by sysdescs[num].  The first string argument is
+// copied (truncated to SYSSTRLEN-1 bytes) only if the process is
+// traced with TRACE_STR.
+static void
+getargs(struct proc *p, int num, int *argv, char *str)
+{
+  struct sysdesc *d = &sysdescs[num];
+  char *s;
+  int i;
+
+  str[0] = 0;
+  for(i = 0; i < d->nargs; i++){
+    if(argint(i, &argv[i]) < 0)
+      argv[i] = 0;
+    if(d->type[i] == AT_STR && (p->traceflags & TRACE_STR) && str[0] == 0 &&
+       fetchstr(argv[i], &s) >= 0)
+      safestrcpy(str, s, SYSSTRLEN);
+  }
+}
+
+// Name of system call num, for diagnostics.
+char*
+syscallname(int num)
+{
+  if(num <= 0 || num >= nsysdescs || sysdescs[num].name == 0)
+    return "?";
+  return sysdescs[num].name;
+}
+
+// Print one history record of process pid, rendering the
+// argument types from the descriptor table.
+void
+printsysrec(int pid, struct sysrec *r)
+{
+  struct sysdesc *d = &sysdescs[r->num];
+  int i, t, str;
+
+  cprintf("%d %s(", pid, d->name);
+  str = r->str[0] != 0;
+  for(i = 0; i < d->nargs; i++){
+    t = d->type[i];
+    if(i > 0)
+      cprintf(", ");
+    if(t == AT_STR && str){
+      cprintf("%s \"%s\"", argtypenames[t], r->str);
+      str = 0;
+    } else if(t == AT_INT || t == AT_UINT || t == AT_SHORT)
+      cprintf("%s %d", argtypenames[t], r->argv[i]);
+    else
+      cprintf("%s 0x%x", argtypenames[t], r->argv[i]);
+  }
+  cprintf(") @ TICKS: %d\n", r->ticks);
 }
 
 void
@@ -378,44 +334,91 @@ syscall(void)
 
   num = curproc->tf->eax;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
-    curproc->tf->eax = syscalls[num]();
-    if (first_proc == 0){
-      first_proc = (struct node*) kalloc();
-      safestrcpy(first_proc->name, syscalls_string[num-1], strlen(syscalls_string[num-1])+1);
-      cmostime(&(first_proc -> date));
-      first_proc -> pid = curproc -> pid;
-      first_proc -> next = 0;
-      last_proc = first_proc;
-    }else{
-      last_proc -> next = (struct node*) kalloc();
-      safestrcpy(last_proc -> next->name, syscalls_string[num-1], strlen(syscalls_string[num-1])+1);
-      cmostime(&(last_proc -> next-> date));
-      last_proc -> next -> pid = curproc -> pid;
-      last_proc -> next -> next = 0;
-      last_proc = last_proc -> next;
-    }
-    if (curproc->syscalls[num-1].count == 0){
-    	curproc->syscalls[num-1].datelist = (struct date*)kalloc();
-    	curproc->syscalls[num-1].datelist->next = 0;
-    	curproc->syscalls[num-1].datelist_end = curproc->syscalls[num-1].datelist;
-    	curproc->syscalls[num-1].arglist = (struct syscallarg*)kalloc();
-    	curproc->syscalls[num-1].arglist->next = 0;
-    	curproc->syscalls[num-1].arglist_end = curproc->syscalls[num-1].arglist;
-    }else{
-    	curproc->syscalls[num-1].datelist_end->next = (struct date*)kalloc();
-      curproc->syscalls[num-1].datelist_end->next->next = 0;
-    	curproc->syscalls[num-1].datelist_end = curproc->syscalls[num-1].datelist_end->next;
-    	curproc->syscalls[num-1].arglist_end->next = (struct syscallarg*)kalloc();
-      curproc->syscalls[num-1].arglist_end->next->next = 0;
-    	curproc->syscalls[num-1].arglist_end = curproc->syscalls[num-1].arglist_end->next;
-    }
-    curproc->syscalls[num-1].count = curproc->syscalls[num-1].count + 1;
-    safestrcpy(curproc->syscalls[num-1].name, syscalls_string[num-1], strlen(syscalls_string[num-1])+1);
-   	cmostime(&(curproc->syscalls[num-1].datelist_end->date));
-   	fill_arglist(curproc->syscalls[num-1].arglist_end, num);
+    curproc->insyscall = 1;
+    curproc->tf->eax = dosyscall(curproc, num);
+    curproc->insyscall = 0;
   } else {
     cprintf("%d %s: unknown sys call %d\n",
             curproc->pid, curproc->name, num);
     curproc->tf->eax = -1;
   }
 }
+
+// Run system call num for a batched submission whose arguments
+// start at user address argp+4, the layout argint() expects on
+// the user stack.  Used by ring_enter.
+int
+syscallat(int num, uint argp)
+{
+  struct proc *curproc = myproc();
+  uint esp;
+  int ret;
+
+  if(num <= 0 || num >= NELEM(syscalls) || syscalls[num] == 0)
+    return -1;
+  esp = curproc->tf->esp;
+  curproc->tf->esp = argp;
+  ret = dosyscall(curproc, num);
+  curproc->tf->esp = esp;
+  return ret;
+}
+
+static uint64
+rankval(struct sysstat *st, int key)
+{
+  switch(key){
+  case SORT_TIME:
+    return st->cycles;
+  case SORT_LAST:
+    return st->last;
+  default:
+    return st->count;
+  }
+}
+
+// Rank the system calls of pid, or of the whole system if pid
+// is 0, by key and return the top n rows in out.  Only the n
+// best rows are kept while scanning (a partial insertion sort).
+// Returns the number of rows filled, or -1 if pid does not exist.
+int
+sysrank(int pid, int key, struct sysrank *out, int n)
+{
+  struct sysstat st[SYS_CALL_COUNT+1];
+  uint64 v, top[SYS_CALL_COUNT];
+  int i, j, c, m;
+
+  if(n > SYS_CALL_COUNT)
+    n = SYS_CALL_COUNT;
+  if(pid == 0){
+    memset(st, 0, sizeof(st));
+    for(c = 0; c < ncpu; c++){
+      for(i = 1; i <= SYS_CALL_COUNT; i++){
+        st[i].count += cpustat[c][i].count;
+        st[i].cycles += cpustat[c][i].cycles;
+        if(cpustat[c][i].last > st[i].last)
+          st[i].last = cpustat[c][i].last;
+      }
+    }
+  } else if(getsysstat(pid, st) < 0)
+    return -1;
+
+  m = 0;
+  for(i = 1; i <= SYS_CALL_COUNT; i++){
+    if(st[i].count == 0)
+      continue;
+    v = rankval(&st[i], key);
+    if(m == n && (n == 0 || v <= top[n-1]))
+      continue;
+    j = m < n ? m++ : n-1;
+    for(; j > 0 && top[j-1] < v; j--){
+      top[j] = top[j-1];
+      out[j] = out[j-1];
+    }
+    top[j] = v;
+    out[j].num = i;
+    out[j].count = st[i].count;
+    out[j].kcycles = st[i].cycles >> 10;
+    out[j].last = st[i].last;
+  }
+  return m;
+}
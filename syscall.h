@@ -39,4 +39,13 @@
 #define SYS_shm_init 38
 #define SYS_shm_open 39
 #define SYS_shm_attach 40
-#define SYS_shm_close 41
\ No newline at end of file
+#define SYS_shm_close 41
+#define SYS_trace 42
+#define SYS_ring_setup 43
+#define SYS_ring_enter 44
+#define SYS_memstat 45
+#define SYS_spawn 46
+#define SYS_mmap 47
+#define SYS_munmap 48
+#define SYS_superpages 49
+#define SYS_memlimit 50
@@ -74,7 +74,7 @@ sys_read(void)
   int n;
   char *p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argoutptr(1, &p, n) < 0)
     return -1;
   return fileread(f, p, n);
 }
@@ -110,7 +110,7 @@ sys_fstat(void)
   struct file *f;
   struct stat *st;
 
-  if(argfd(0, 0, &f) < 0 || argptr(1, (void*)&st, sizeof(*st)) < 0)
+  if(argfd(0, 0, &f) < 0 || argoutptr(1, (void*)&st, sizeof(*st)) < 0)
     return -1;
   return filestat(f, st);
 }
@@ -421,6 +421,35 @@ sys_exec(void)
   return exec(path, argv);
 }
 
+// spawn(path, argv, fdmap, nfd): start path in a new child
+// process whose fd i is our fd fdmap[i].
+int
+sys_spawn(void)
+{
+  char *path, *argv[MAXARG];
+  int i, nfd, *fdmap;
+  uint uargv, uarg;
+
+  if(argstr(0, &path) < 0 || argint(1, (int*)&uargv) < 0 ||
+     argint(3, &nfd) < 0 || nfd < 0 || nfd > NOFILE ||
+     argptr(2, (char**)&fdmap, nfd*sizeof(int)) < 0)
+    return -1;
+  memset(argv, 0, sizeof(argv));
+  for(i=0;; i++){
+    if(i >= NELEM(argv))
+      return -1;
+    if(fetchint(uargv+4*i, (int*)&uarg) < 0)
+      return -1;
+    if(uarg == 0){
+      argv[i] = 0;
+      break;
+    }
+    if(fetchstr(uarg, &argv[i]) < 0)
+      return -1;
+  }
+  return spawn(path, argv, fdmap, nfd);
+}
+
 int
 sys_pipe(void)
 {
@@ -428,7 +457,7 @@ sys_pipe(void)
   struct file *rf, *wf;
   int fd0, fd1;
 
-  if(argptr(0, (void*)&fd, 2*sizeof(fd[0])) < 0)
+  if(argoutptr(0, (void*)&fd, 2*sizeof(fd[0])) < 0)
     return -1;
   if(pipealloc(&rf, &wf) < 0)
     return -1;
@@ -444,3 +473,30 @@ sys_pipe(void)
   fd[1] = fd1;
   return 0;
 }
+
+// mmap(fd, off, len, prot): map part of an open file.
+int
+sys_mmap(void)
+{
+  struct file *f;
+  int off, len, prot;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &off) < 0 ||
+     argint(2, &len) < 0 || argint(3, &prot) < 0)
+    return -1;
+  if(off < 0 || len <= 0)
+    return -1;
+  return mmap(f, off, len, prot);
+}
+
+int
+sys_munmap(void)
+{
+  int addr, len;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0)
+    return -1;
+  if(len <= 0)
+    return -1;
+  return munmap(addr, len);
+}
@@ -12,8 +12,9 @@
 #include "semaphore.h"
 #include "rw_lock.h"
 #include "wr_lock.h"
+#include "trace.h"
+#include "memstat.h"
 
-extern struct node* first_proc;
 struct ticket_lock ticketlock;
 struct rw_lock rwLock;
 struct wr_lock wrLock;
@@ -61,11 +62,10 @@ sys_inc_num(void)
   return 0;
 }
 
+// The segment table is set up at boot now; kept for old programs.
 void
 sys_shm_init(void)
 {
-  shminit();
-  cprintf("oo\n");
 }
 
 int
@@ -111,19 +111,76 @@ sys_invoked_syscalls(void)
   return -1;
 }
 
+// sort_syscalls(pid, buf, n, key): copy the top n system calls
+// of pid (0 for system-wide) ranked by key into buf.
+// Returns the number of rows written.
 int
 sys_sort_syscalls(void)
 {
-  int pid, i;
+  int pid, n, key, m;
+  struct sysrank *buf, rows[SYS_CALL_COUNT];
 
-  if(argint(0, &pid) < 0)
+  if(argint(0, &pid) < 0 || argint(2, &n) < 0 || argint(3, &key) < 0)
     return -1;
-  cprintf("num : %d\n", pid);
-  i = invocation_log(pid);
-  if(i >= 0){
-    return 0;
-  }
-  return -1;
+  if(n < 0)
+    return -1;
+  if(n > SYS_CALL_COUNT)
+    n = SYS_CALL_COUNT;
+  if(argoutptr(1, (void*)&buf, n*sizeof(*buf)) < 0)
+    return -1;
+  if((m = sysrank(pid, key, rows, n)) < 0)
+    return -1;
+  memmove(buf, rows, m*sizeof(*buf));
+  return m;
+}
+
+// trace(pid, flags): set the TRACE_* flags of pid.
+int
+sys_trace(void)
+{
+  int pid, flags;
+
+  if(argint(0, &pid) < 0 || argint(1, &flags) < 0)
+    return -1;
+  return settrace(pid, flags);
+}
+
+// ring_setup(ring): register a page of user memory as the
+// batched system call ring, or unregister with 0.
+int
+sys_ring_setup(void)
+{
+  int va;
+
+  if(argint(0, &va) < 0)
+    return -1;
+  return ringsetup(va);
+}
+
+// ring_enter(n): run up to n queued submissions.
+int
+sys_ring_enter(void)
+{
+  int n;
+
+  if(argint(0, &n) < 0)
+    return -1;
+  return ringenter(n);
+}
+
+// memstat(st): copy out physical memory statistics.
+int
+sys_memstat(void)
+{
+  struct memstat *st;
+
+  if(argoutptr(0, (char**)&st, sizeof(*st)) < 0)
+    return -1;
+  kmemstat(st);
+  pcstat(st);
+  swapstat(st);
+  procmemstat(st);
+  return 0;
 }
 
 int
@@ -134,14 +191,13 @@ sys_get_count(void)
   if (argint(0, &pid) < 0 || argint(1, &sysnum) < 0)
     return -1;
   result = get_syscall_count(pid, sysnum);
-  cprintf("count_syscall: pid: %d sysnum: %d res:%d\n", pid, sysnum, result);
   return result;
 }
 
 void
 sys_log_syscalls(void)
 {
-  log_syscalls(first_proc);
+  traceprint();
 }
 
 void
@@ -284,6 +340,35 @@ sys_sbrk(void)
   return addr;
 }
 
+// superpages(on): map this process's heap with 4MB pages from
+// now on where possible, or stop.  Children inherit the setting.
+// Returns the old setting.
+int
+sys_superpages(void)
+{
+  int on, old;
+
+  if(argint(0, &on) < 0)
+    return -1;
+  old = myproc()->superpages;
+  myproc()->superpages = on != 0;
+  return old;
+}
+
+// memlimit(pages, group): limit this process to pages pages of
+// address space, 0 for none, or with group set, start a new
+// memory group with that limit for this process and the
+// children it has from now on.  See oom.c.
+int
+sys_memlimit(void)
+{
+  int pages, group;
+
+  if(argint(0, &pages) < 0 || argint(1, &group) < 0 || pages < 0)
+    return -1;
+  return memlimit(pages, group);
+}
+
 int
 sys_sleep(void)
 {
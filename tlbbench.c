@@ -0,0 +1,95 @@
+// tlbbench: cost of TLB misses with 4KB pages and with superpages.
+// Usage: tlbbench [mb] [passes]
+// A child grows its heap by mb megabytes (default 32, rounded
+// down to a power of two), 4MB aligned, and touches every page;
+// then it reads one word from each page in a scattered order,
+// passes times (default 16), so that nearly every read misses
+// the TLB.  That runs once with 4KB pages and once with
+// superpages(1).
+
+#include "types.h"
+#include "param.h"
+#include "stat.h"
+#include "user.h"
+#include "x86.h"
+#include "memstat.h"
+
+#define SUPER (4*1024*1024)
+
+struct memstat ms;
+uint sink;          // keeps the reads from being optimized away
+
+// Page table pages of this process, from memstat.
+int
+pgtbls(void)
+{
+  int i, pid;
+
+  pid = getpid();
+  if(memstat(&ms) < 0)
+    return -1;
+  for(i = 0; i < ms.nproc; i++)
+    if(ms.proc[i].pid == pid)
+      return ms.proc[i].pgtbl;
+  return -1;
+}
+
+void
+run(int super, uint size, int passes)
+{
+  char *cur, *base;
+  uint pad, npages, i, j, t0, dt, sum;
+  int pass;
+
+  superpages(super);
+  cur = sbrk(0);
+  pad = (SUPER - (uint)cur % SUPER) % SUPER;
+  if(sbrk(pad + size) == (char*)-1){
+    printf(2, "tlbbench: sbrk failed\n");
+    return;
+  }
+  base = cur + pad;
+  npages = size / 4096;
+  for(i = 0; i < npages; i++)
+    base[i*4096] = i;
+
+  sum = 0;
+  j = 0;
+  t0 = (uint)rdtsc();
+  for(pass = 0; pass < passes; pass++){
+    for(i = 0; i < npages; i++){
+      // Full-period LCG over the page numbers.
+      j = (j*1664525 + 1013904223) & (npages - 1);
+      sum += base[j*4096];
+    }
+  }
+  dt = (uint)rdtsc() - t0;
+  sink = sum;
+
+  printf(1, "%s: %d cycles/read, %d kcycles in all, %d page table pages\n",
+         super ? "4MB pages" : "4KB pages", dt / (npages*passes),
+         dt >> 10, pgtbls());
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint mb, size;
+  int passes, super;
+
+  mb = argc > 1 ? atoi(argv[1]) : 32;
+  passes = argc > 2 ? atoi(argv[2]) : 16;
+  for(size = SUPER; size*2 <= mb*1024*1024; size *= 2)
+    ;
+  if(passes < 1)
+    passes = 1;
+
+  for(super = 0; super < 2; super++){
+    if(fork() == 0){
+      run(super, size, passes);
+      exit();
+    }
+    wait();
+  }
+  exit();
+}
@@ -0,0 +1,45 @@
+// topsys: show the most used system calls.
+// Usage: topsys [-t | -l] [pid] [n]
+//   -t  rank by total time, -l  rank by last use (default: count)
+//   pid 0 or omitted means system-wide.
+
+#include "types.h"
+#include "param.h"
+#include "stat.h"
+#include "user.h"
+#include "trace.h"
+#include "sysargs.h"
+
+struct sysrank rows[64];
+
+int
+main(int argc, char *argv[])
+{
+  int i, m, key, pid, n;
+  char *name;
+
+  key = SORT_COUNT;
+  i = 1;
+  if(argc > i && argv[i][0] == '-'){
+    if(argv[i][1] == 't')
+      key = SORT_TIME;
+    else if(argv[i][1] == 'l')
+      key = SORT_LAST;
+    i++;
+  }
+  pid = argc > i ? atoi(argv[i++]) : 0;
+  n = argc > i ? atoi(argv[i]) : 10;
+  if(n > 64)
+    n = 64;
+
+  if((m = sort_syscalls(pid, rows, n, key)) < 0){
+    printf(2, "topsys: no such pid %d\n", pid);
+    exit();
+  }
+  printf(1, "SYSCALL\t\tCOUNT\tKCYCLES\tLAST\n");
+  for(i = 0; i < m; i++){
+    name = rows[i].num < nsysdescs ? sysdescs[rows[i].num].name : "?";
+    printf(1, "%s\t\t%d\t%d\t%d\n", name, rows[i].count, rows[i].kcycles, rows[i].last);
+  }
+  exit();
+}
@@ -0,0 +1,101 @@
+// System call trace device.
+// syscall() appends a fixed-size binary record per call to a
+// ring buffer; user space drains it in bulk by reading /dev/trace
+// and decodes it offline (see tracedump.c).  The kernel never
+// formats records and never holds ptable.lock here.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "trace.h"
+
+struct {
+  struct spinlock lock;
+  struct traceev ring[NTRACE];
+  uint r;     // next sequence number to be read
+  uint w;     // next sequence number to be written
+} trace;
+
+// Record one completed system call.  If the reader has fallen
+// more than NTRACE records behind, the oldest ones are dropped;
+// the gap shows up as a jump in seq.
+void
+tracelog(int pid, int num, int ret, int *argv, char *str, int flags)
+{
+  struct traceev *e;
+
+  acquire(&trace.lock);
+  if(trace.w - trace.r == NTRACE)
+    trace.r++;
+  e = &trace.ring[trace.w % NTRACE];
+  e->seq = trace.w++;
+  e->ticks = ticks;
+  e->pid = pid;
+  e->num = num;
+  e->cpu = cpuid();
+  e->flags = flags;
+  e->ret = ret;
+  memmove(e->argv, argv, sizeof(e->argv));
+  memmove(e->str, str, sizeof(e->str));
+  release(&trace.lock);
+}
+
+// Copy out as many whole records as fit in n bytes.
+// Records are consumed; returns 0 when the ring is empty.
+int
+traceread(struct inode *ip, char *dst, int n)
+{
+  struct traceev e;
+  int tot;
+
+  iunlock(ip);
+  for(tot = 0; tot + (int)sizeof(e) <= n; tot += sizeof(e)){
+    acquire(&trace.lock);
+    if(trace.r == trace.w){
+      release(&trace.lock);
+      break;
+    }
+    e = trace.ring[trace.r++ % NTRACE];
+    release(&trace.lock);
+    memmove(dst + tot, &e, sizeof(e));
+  }
+  ilock(ip);
+  return tot;
+}
+
+// Print the records still in the ring without consuming them.
+// Used by the log_syscalls system call.
+void
+traceprint(void)
+{
+  struct traceev e;
+  uint seq;
+
+  acquire(&trace.lock);
+  seq = trace.r;
+  release(&trace.lock);
+  for(;;){
+    acquire(&trace.lock);
+    if(seq < trace.r)
+      seq = trace.r;
+    if(seq == trace.w){
+      release(&trace.lock);
+      break;
+    }
+    e = trace.ring[seq++ % NTRACE];
+    release(&trace.lock);
+    cprintf("Syscall name: %s @ TICKS: %d by Process: %d on cpu%d returned %d\n",
+            syscallname(e.num), e.ticks, e.pid, e.cpu, e.ret);
+  }
+}
+
+void
+traceinit(void)
+{
+  initlock(&trace.lock, "trace");
+  devsw[TRACE].read = traceread;
+}
@@ -0,0 +1,33 @@
+// System call tracing and statistics, as seen by user space.
+// The kernel only fills these in; tracedump and topsys decode them.
+
+// Binary trace record, as read from /dev/trace.
+// Include param.h first.  Argument types come from sysdescs[num].
+struct traceev {
+  uint seq;      // Global sequence number (gaps mean dropped records)
+  uint ticks;    // Value of ticks when the call returned
+  int pid;       // Calling process
+  ushort num;    // System call number (SYS_*)
+  uchar cpu;     // CPU the call ran on
+  uchar flags;   // Caller's TRACE_* flags
+  int ret;       // Return value in %eax
+  int argv[MAXSYSARGS];   // Raw argument values
+  char str[SYSSTRLEN];    // First string argument, if TRACE_STR
+};
+
+// Flags for trace(pid, flags).
+#define TRACE_STR   0x1   // capture string arguments
+#define TRACE_REC   0x2   // mark records for tracerecord
+
+// Ranking keys for sort_syscalls().
+#define SORT_COUNT  0   // most calls first
+#define SORT_TIME   1   // most total time first
+#define SORT_LAST   2   // most recently used first
+
+// One row of a sort_syscalls() result.
+struct sysrank {
+  int num;       // System call number
+  uint count;    // Number of calls
+  uint kcycles;  // Total time spent, in units of 1024 TSC cycles
+  uint last;     // ticks at the most recent call
+};
@@ -0,0 +1,70 @@
+// tracedump: drain /dev/trace and decode the binary
+// system call records.  Usage: tracedump [pid]
+
+#include "types.h"
+#include "param.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "trace.h"
+#include "sysargs.h"
+
+struct traceev buf[64];
+
+void
+printev(struct traceev *e)
+{
+  struct sysdesc *d;
+  int i, t, str;
+
+  if(e->num >= nsysdescs || sysdescs[e->num].name == 0){
+    printf(1, "%d\t%d\tpid %d\tcpu%d\t?%d() = %d\n",
+           e->seq, e->ticks, e->pid, e->cpu, e->num, e->ret);
+    return;
+  }
+  d = &sysdescs[e->num];
+  printf(1, "%d\t%d\tpid %d\tcpu%d\t%s(", e->seq, e->ticks, e->pid, e->cpu, d->name);
+  str = e->str[0] != 0;
+  for(i = 0; i < d->nargs; i++){
+    t = d->type[i];
+    if(i > 0)
+      printf(1, ", ");
+    if(t == AT_STR && str){
+      printf(1, "%s \"%s\"", argtypenames[t], e->str);
+      str = 0;
+    } else if(t == AT_INT || t == AT_UINT || t == AT_SHORT)
+      printf(1, "%s %d", argtypenames[t], e->argv[i]);
+    else
+      printf(1, "%s 0x%x", argtypenames[t], e->argv[i]);
+  }
+  printf(1, ") = %d\n", e->ret);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd, n, i, pid;
+  uint next;
+  struct traceev *e;
+
+  pid = argc > 1 ? atoi(argv[1]) : 0;
+  if((fd = open("trace", O_RDONLY)) < 0){
+    printf(2, "tracedump: cannot open trace\n");
+    exit();
+  }
+
+  next = 0;
+  while((n = read(fd, buf, sizeof(buf))) > 0){
+    for(i = 0; i < n / sizeof(buf[0]); i++){
+      e = &buf[i];
+      if(next != 0 && e->seq != next)
+        printf(1, "-- %d records dropped --\n", e->seq - next);
+      next = e->seq + 1;
+      if(pid && e->pid != pid)
+        continue;
+      printev(e);
+    }
+  }
+  close(fd);
+  exit();
+}
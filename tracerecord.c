@@ -0,0 +1,122 @@
+// tracerecord: run a command and save the binary system call
+// stream of it and its children to a file, for tracereplay.
+// Usage: tracerecord file cmd [args...]
+
+#include "types.h"
+#include "param.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "syscall.h"
+#include "trace.h"
+#include "memstat.h"
+
+struct traceev buf[64], out[64];
+struct memstat ms;
+
+// Is pid still in the process table, that is, not yet reaped?
+int
+alive(int pid)
+{
+  int i;
+
+  if(memstat(&ms) < 0)
+    return 0;
+  for(i = 0; i < ms.nproc; i++)
+    if(ms.proc[i].pid == pid)
+      return 1;
+  return 0;
+}
+
+// Copy records marked TRACE_REC from /dev/trace to fd until
+// the trace() call made by process done shows up, or the ring
+// is empty and cmd has been reaped.  Gaps in seq are records
+// that were dropped, or that another reader took.
+void
+drain(int tfd, int fd, int done, int cmd)
+{
+  int i, n, m, started;
+  uint next, lost;
+
+  started = 0;
+  next = lost = 0;
+  for(;;){
+    if((n = read(tfd, buf, sizeof(buf))) < 0){
+      printf(2, "tracerecord: read error\n");
+      break;
+    }
+    n /= sizeof(buf[0]);
+    if(n == 0){
+      if(!alive(cmd))
+        break;
+      sleep(1);
+      continue;
+    }
+    m = 0;
+    for(i = 0; i < n; i++){
+      if(started && buf[i].seq != next)
+        lost += buf[i].seq - next;
+      started = 1;
+      next = buf[i].seq + 1;
+      if(buf[i].pid == done && buf[i].num == SYS_trace)
+        break;
+      if(buf[i].flags & TRACE_REC)
+        out[m++] = buf[i];
+    }
+    if(m > 0 && write(fd, out, m * sizeof(out[0])) != m * sizeof(out[0])){
+      printf(2, "tracerecord: write error\n");
+      break;
+    }
+    if(i < n)
+      break;
+  }
+  if(lost > 0)
+    printf(2, "tracerecord: %d records lost, recording is incomplete\n", lost);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd, tfd, me, pid, wpid;
+
+  if(argc < 3){
+    printf(2, "usage: tracerecord file cmd [args...]\n");
+    exit();
+  }
+  if((tfd = open("trace", O_RDONLY)) < 0){
+    printf(2, "tracerecord: cannot open trace\n");
+    exit();
+  }
+  if((fd = open(argv[1], O_CREATE | O_WRONLY)) < 0){
+    printf(2, "tracerecord: cannot create %s\n", argv[1]);
+    exit();
+  }
+
+  // Throw away whatever is already in the ring.
+  while(read(tfd, buf, sizeof(buf)) > 0)
+    ;
+
+  me = getpid();
+  if((pid = fork()) == 0){
+    close(fd);
+    close(tfd);
+    trace(getpid(), TRACE_STR | TRACE_REC);
+    exec(argv[2], argv + 2);
+    printf(2, "tracerecord: exec %s failed\n", argv[2]);
+    exit();
+  }
+  if(fork() == 0){
+    drain(tfd, fd, me, pid);
+    close(fd);
+    exit();
+  }
+  close(fd);
+
+  while((wpid = wait()) >= 0 && wpid != pid)
+    ;
+
+  // This call is the drainer's cue that the command is done.
+  trace(me, 0);
+  wait();
+  exit();
+}
@@ -0,0 +1,193 @@
+// tracereplay: re-issue a system call stream saved by tracerecord.
+// Usage: tracereplay file [nproc] [speedup]
+//   Each of nproc processes replays the whole stream.  speedup 1
+//   keeps the recorded inter-arrival times, k runs k times faster
+//   and 0 issues the calls back to back.
+// Calls that would change the replayer itself (fork, exec, exit,
+// kill, sbrk, ...) are counted as skipped.
+
+#include "types.h"
+#include "param.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "syscall.h"
+#include "trace.h"
+
+#define NPMAP 16   // recorded processes tracked per replayer
+
+// Recorded file descriptors of one recorded process,
+// mapped to the replayer's own descriptors.
+struct pmap {
+  int pid;
+  int fd[NOFILE];
+};
+
+struct pmap pmaps[NPMAP];
+char scratch[4096];
+
+struct pmap*
+getpmap(int pid)
+{
+  struct pmap *m;
+  int i;
+
+  for(m = pmaps; m < &pmaps[NPMAP]; m++)
+    if(m->pid == pid)
+      return m;
+  for(m = pmaps; m < &pmaps[NPMAP]; m++){
+    if(m->pid == 0){
+      m->pid = pid;
+      for(i = 0; i < NOFILE; i++)
+        m->fd[i] = -1;
+      return m;
+    }
+  }
+  return 0;
+}
+
+// Translate a recorded descriptor to a live one, or -1.
+int
+mapfd(struct pmap *m, int fd)
+{
+  if(fd < 0 || fd >= NOFILE)
+    return -1;
+  return m->fd[fd];
+}
+
+void
+setfd(struct pmap *m, int recfd, int fd)
+{
+  if(recfd < 0 || recfd >= NOFILE){
+    if(fd >= 0)
+      close(fd);
+    return;
+  }
+  if(m->fd[recfd] >= 0)
+    close(m->fd[recfd]);
+  m->fd[recfd] = fd;
+}
+
+// Re-issue one recorded call.  Returns 0 if it was skipped.
+int
+replay1(struct traceev *e)
+{
+  struct pmap *m;
+  struct stat st;
+  int fd, n;
+
+  if((m = getpmap(e->pid)) == 0)
+    return 0;
+  switch(e->num){
+  case SYS_open:
+    if(e->str[0] == 0)
+      return 0;
+    setfd(m, e->ret, open(e->str, e->argv[1]));
+    return 1;
+  case SYS_close:
+    setfd(m, e->argv[0], -1);
+    return 1;
+  case SYS_dup:
+    if((fd = mapfd(m, e->argv[0])) < 0)
+      return 0;
+    setfd(m, e->ret, dup(fd));
+    return 1;
+  case SYS_read:
+  case SYS_write:
+    if((fd = mapfd(m, e->argv[0])) < 0)
+      return 0;
+    n = e->argv[2];
+    if(n > sizeof(scratch))
+      n = sizeof(scratch);
+    if(e->num == SYS_read)
+      read(fd, scratch, n);
+    else
+      write(fd, scratch, n);
+    return 1;
+  case SYS_fstat:
+    if((fd = mapfd(m, e->argv[0])) < 0)
+      return 0;
+    fstat(fd, &st);
+    return 1;
+  case SYS_mkdir:
+  case SYS_unlink:
+    if(e->str[0] == 0)
+      return 0;
+    if(e->num == SYS_mkdir)
+      mkdir(e->str);
+    else
+      unlink(e->str);
+    return 1;
+  case SYS_getpid:
+    getpid();
+    return 1;
+  case SYS_uptime:
+    uptime();
+    return 1;
+  }
+  return 0;
+}
+
+void
+replay(struct traceev *ev, int n, int speedup)
+{
+  int i, done, skipped;
+  uint start, due, now;
+
+  done = skipped = 0;
+  start = uptime();
+  for(i = 0; i < n; i++){
+    if(speedup > 0){
+      due = start + (ev[i].ticks - ev[0].ticks) / speedup;
+      now = uptime();
+      if(due > now)
+        sleep(due - now);
+    }
+    if(replay1(&ev[i]))
+      done++;
+    else
+      skipped++;
+  }
+  printf(1, "replayer %d: %d calls replayed, %d skipped in %d ticks\n",
+         getpid(), done, skipped, uptime() - start);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd, i, n, nproc, speedup;
+  struct stat st;
+  struct traceev *ev;
+
+  if(argc < 2){
+    printf(2, "usage: tracereplay file [nproc] [speedup]\n");
+    exit();
+  }
+  nproc = argc > 2 ? atoi(argv[2]) : 1;
+  speedup = argc > 3 ? atoi(argv[3]) : 1;
+  if(nproc < 1)
+    nproc = 1;
+
+  if((fd = open(argv[1], O_RDONLY)) < 0 || fstat(fd, &st) < 0){
+    printf(2, "tracereplay: cannot open %s\n", argv[1]);
+    exit();
+  }
+  n = st.size / sizeof(struct traceev);
+  if((ev = malloc(n * sizeof(struct traceev) + 1)) == 0 ||
+     read(fd, ev, n * sizeof(struct traceev)) != n * sizeof(struct traceev)){
+    printf(2, "tracereplay: cannot read %s\n", argv[1]);
+    exit();
+  }
+  close(fd);
+  printf(1, "tracereplay: %d calls, %d processes, speedup %d\n", n, nproc, speedup);
+
+  for(i = 0; i < nproc; i++){
+    if(fork() == 0){
+      replay(ev, n, speedup);
+      exit();
+    }
+  }
+  for(i = 0; i < nproc; i++)
+    wait();
+  exit();
+}
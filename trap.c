@@ -23,6 +23,11 @@ tvinit(void)
   for(i = 0; i < 256; i++)
     SETGATE(idt[i], 0, SEG_KCODE<<3, vectors[i], 0);
   SETGATE(idt[T_SYSCALL], 1, SEG_KCODE<<3, vectors[T_SYSCALL], DPL_USER);
+  // A double fault is most likely a kernel stack overflow, and
+  // the overflowed stack cannot take the trap frame: switch to a
+  // task with a stack of its own instead.
+  SETGATE(idt[T_DBLFLT], 0, SEG_DFTSS<<3, 0, 0);
+  idt[T_DBLFLT].type = STS_TG;
 
   initlock(&tickslock, "time");
 }
@@ -33,6 +38,21 @@ idtinit(void)
   lidt(idt, sizeof(idt));
 }
 
+// The double fault task.  The task switch saved the state of
+// the code that faulted in this CPU's TSS.  There is no going
+// back to it.
+void
+doublefault(void)
+{
+  struct cpu *c = mycpu();
+
+  if(kstackguard(rcr2()))
+    cprintf("kernel stack overflow: ");
+  cprintf("double fault on cpu %d eip %x esp %x (cr2=0x%x)\n",
+          cpuid(), c->ts.eip, c->ts.esp, rcr2());
+  panic("double fault");
+}
+
 //PAGEBREAK: 41
 void
 trap(struct trapframe *tf)
@@ -52,17 +72,19 @@ trap(struct trapframe *tf)
     if(cpuid() == 0){
       acquire(&tickslock);
       ticks++;
+      kinfotick();
       wakeup(&ticks);
       release(&tickslock);
     }
     lapiceoi();
     break;
   case T_IRQ0 + IRQ_IDE:
-    ideintr();
+    ideintr(0);
     lapiceoi();
     break;
-  case T_IRQ0 + IRQ_IDE+1:
-    // Bochs generates spurious IDE1 interrupts.
+  case T_IRQ0 + IRQ_IDE2:
+    ideintr(1);
+    lapiceoi();
     break;
   case T_IRQ0 + IRQ_KBD:
     kbdintr();
@@ -79,10 +101,21 @@ trap(struct trapframe *tf)
     lapiceoi();
     break;
 
+  case T_PGFLT:
+    // A first touch of lazily grown memory or a write to a
+    // copy-on-write page, either from user space or from the
+    // kernel using user memory on the process's behalf
+    // (CR0_WP makes the kernel honor PTE_W too).
+    if(myproc() && pagefault(myproc(), rcr2(), tf->err) == 0)
+      break;
+    // fall through
+
   //PAGEBREAK: 13
   default:
     if(myproc() == 0 || (tf->cs&3) == 0){
       // In kernel, it must be our mistake.
+      if(tf->trapno == T_PGFLT && kstackguard(rcr2()))
+        cprintf("kernel stack overflow: ");
       cprintf("unexpected trap %d from cpu %d eip %x (cr2=0x%x)\n",
               tf->trapno, cpuid(), tf->eip, rcr2());
       panic("trap");
@@ -1,5 +1,8 @@
 struct stat;
 struct rtcdate;
+struct sysrank;
+struct ring;
+struct memstat;
 
 // system calls
 int fork(void);
@@ -19,9 +22,18 @@ void* shm_attach(int id);
 int shm_close(int id);
 int inc_num(int num);
 void invoked_syscalls(int pid);
-void sort_syscalls(int pid);
+int sort_syscalls(int pid, struct sysrank*, int n, int key);
 int get_count(int pid, int sysnum);
 void log_syscalls(void);
+int trace(int pid, int flags);
+int ring_setup(struct ring*);
+int ring_enter(int n);
+int memstat(struct memstat*);
+int spawn(char*, char**, int*, int);
+void* mmap(int, int, int, int);
+int munmap(void*, int);
+int superpages(int);
+int memlimit(uint, int);
 int exit(void) __attribute__((noreturn));
 int wait(void);
 int pipe(int*);
@@ -57,3 +69,6 @@ void* memset(void*, int, uint);
 void* malloc(uint);
 void free(void*);
 int atoi(const char*);
+
+// fineuptime.c
+uint fineuptime(void);
@@ -6,10 +6,16 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "memstat.h"
 #include "elf.h"
+#include "kinfo.h"
 
 extern char data[];  // defined by kernel.ld
 pde_t *kpgdir;  // for use in scheduler()
+static pte_t *kstackpt;  // page table of the kernel stack region, shared
+struct kinfo *kinfo;  // mapped read-only at KINFO
+
+static void sysenterinit(struct cpu*);
 
 // Set up CPU's kernel segment descriptors.
 // Run once on entry on each CPU.
@@ -27,12 +33,58 @@ seginit(void)
   c->gdt[SEG_KDATA] = SEG(STA_W, 0, 0xffffffff, 0);
   c->gdt[SEG_UCODE] = SEG(STA_X|STA_R, 0, 0xffffffff, DPL_USER);
   c->gdt[SEG_UDATA] = SEG(STA_W, 0, 0xffffffff, DPL_USER);
+
+  // The TSS only needs a new esp0 per process (see switchuvm),
+  // so load it once here.
+  c->gdt[SEG_TSS] = SEG16(STS_T32A, &c->ts, sizeof(c->ts)-1, 0);
+  c->gdt[SEG_TSS].s = 0;
+  c->ts.ss0 = SEG_KDATA << 3;
+  // setting IOPL=0 in eflags *and* iomb beyond the tss segment limit
+  // forbids I/O instructions (e.g., inb and outb) from user space
+  c->ts.iomb = (ushort) 0xFFFF;
+
+  // A double fault switches to this task, on its own stack.
+  c->gdt[SEG_DFTSS] = SEG16(STS_T32A, &c->dfts, sizeof(c->dfts)-1, 0);
+  c->gdt[SEG_DFTSS].s = 0;
+  c->dfts.cr3 = (void*)V2P(kpgdir);
+  c->dfts.eip = (uint*)doublefault;
+  c->dfts.esp = (uint*)(c->dfstack + sizeof(c->dfstack));
+  c->dfts.eflags = 0x2;  // the always-one bit; interrupts off
+  c->dfts.cs = SEG_KCODE << 3;
+  c->dfts.ds = c->dfts.es = c->dfts.ss = SEG_KDATA << 3;
+  c->dfts.fs = c->dfts.gs = SEG_KDATA << 3;
+  c->dfts.iomb = (ushort) 0xFFFF;
+
   lgdt(c->gdt, sizeof(c->gdt));
+  ltr(SEG_TSS << 3);
+  sysenterinit(c);
+}
+
+// Set up the sysenter fast system call path on this CPU.
+// sysenter loads %esp from an MSR, which cannot follow the
+// current process around cheaply, so point it at ts.esp0 instead
+// and let sysenter_entry load the real kernel stack from there.
+// sysenter derives SS from CS+8 and sysexit derives the user
+// CS and SS from CS+16 and CS+24, which matches the GDT layout.
+static void
+sysenterinit(struct cpu *c)
+{
+  extern char sysenter_entry[];
+  uint eax, ebx, ecx, edx;
+
+  x86cpuid(1, &eax, &ebx, &ecx, &edx);
+  if((edx & CPUID_SEP) == 0)
+    return;
+  wrmsr(MSR_SYSENTER_CS, SEG_KCODE << 3);
+  wrmsr(MSR_SYSENTER_ESP, (uint)&c->ts.esp0);
+  wrmsr(MSR_SYSENTER_EIP, (uint)sysenter_entry);
+  kinfo->sysenter = 1;
 }
 
 // Return the address of the PTE in page table pgdir
 // that corresponds to virtual address va.  If alloc!=0,
 // create any required page table pages.
+// Returns 0 for a va in a superpage, which has no PTE.
 static pte_t *
 walkpgdir(pde_t *pgdir, const void *va, int alloc)
 {
@@ -40,13 +92,14 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
   pte_t *pgtab;
 
   pde = &pgdir[PDX(va)];
+  if(*pde & PTE_PS)
+    return 0;
   if(*pde & PTE_P){
     pgtab = (pte_t*)P2V(PTE_ADDR(*pde));
   } else {
-    if(!alloc || (pgtab = (pte_t*)kalloc()) == 0)
-      return 0;
     // Make sure all those PTE_P bits are zero.
-    memset(pgtab, 0, PGSIZE);
+    if(!alloc || (pgtab = (pte_t*)kalloc_zeroed(KM_PGTBL)) == 0)
+      return 0;
     // The permissions here are overly generous, but they can
     // be further restricted by the permissions in the page table
     // entries, if necessary.
@@ -80,47 +133,69 @@ mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm)
   return 0;
 }
 
+// Are pages[0..NPTENTRIES) one 4MB-aligned physical block?
+static int
+shmsuper(char *pages[])
+{
+  uint i;
+
+  if(V2P(pages[0]) % SUPERPGSIZE)
+    return 0;
+  for(i = 1; i < NPTENTRIES; i++)
+    if(pages[i] != pages[0] + i*PGSIZE)
+      return 0;
+  return 1;
+}
+
 //map physical pages starting at start_va_shr
 int
 shm_from_allocuvm(pde_t *pgdir, uint start_va_shr, char* pages[], uint amount_pages, int perm){
-  int j;
-  
-  for(j=0; j < amount_pages; j++)
-    mappages(pgdir, (void*) (start_va_shr + (j * PGSIZE)) , PGSIZE, V2P(pages[j]), perm);
+  uint j, i, a;
+
+  // Each mapping holds a page reference, dropped by freevm().
+  // A 4MB-aligned run of contiguous pages at a 4MB-aligned
+  // address gets one PTE_PS entry; PTE_SHM marks it as still
+  // holding those page references, one for each page.
+  for(j=0; j < amount_pages; j++){
+    a = start_va_shr + j*PGSIZE;
+    if(a % SUPERPGSIZE == 0 && amount_pages - j >= NPTENTRIES &&
+       pgdir[PDX(a)] == 0 && shmsuper(&pages[j])){
+      pgdir[PDX(a)] = V2P(pages[j]) | PTE_PS | PTE_SHM | perm | PTE_P;
+      for(i = 0; i < NPTENTRIES; i++)
+        kref(pages[j + i]);
+      j += NPTENTRIES - 1;
+      continue;
+    }
+    if(mappages(pgdir, (void*)a, PGSIZE, V2P(pages[j]), perm) < 0){
+      deallocuvm(pgdir, a, start_va_shr);
+      return -1;
+    }
+    kref(pages[j]);
+  }
 
   return 0;
 }
 
-// Allocate shared page tables and physical memory to grow process from oldsz to
-// newsz, which need not be page aligned.  Returns new size or 0 on error.
+// Map pages[] into the current process at the highest free
+// range below KERNBASE, where mmap() puts file mappings too, so
+// that the heap keeps the room under them to grow into.
+// Returns the address, or 0 if there is no room.
 int
 shm_allocuvm(pde_t *pgdir,char* pages[], uint amount_pages, int perm)
 {
-  struct proc* proc = (&cpus[cpuid()])->proc;
-  uint sz = PGROUNDUP(proc->sz);
-  pte_t *pte;
-  uint start_va_shr;
-  uint j;
-
-  for(start_va_shr =  sz; start_va_shr <= KERNBASE - (amount_pages * PGSIZE) ; start_va_shr += PGSIZE){
-    for(j = 0; j < amount_pages; j++){
-      pte = walkpgdir(pgdir, (void*) (start_va_shr + (j * PGSIZE)) , 0);
-      if (*pte & PTE_P){
-        start_va_shr +=  j * PGSIZE;
-        break;
-      }
-    }
-    if (j == amount_pages)
-      break;
-  }
-
-  if(start_va_shr > KERNBASE - (amount_pages * PGSIZE))
-    return -1;
-
-  //map physical pages starting at start_va_shr 
-  shm_from_allocuvm(proc->pgdir,start_va_shr, pages, amount_pages, perm);
-
-
+  uint start_va_shr, len;
+
+  // Segments of 4MB or more start 4MB-aligned if there is room,
+  // for superpages (see shm_from_allocuvm).
+  len = amount_pages * PGSIZE;
+  start_va_shr = 0;
+  if(len >= SUPERPGSIZE)
+    start_va_shr = vmaspace(myproc(), len, SUPERPGSIZE);
+  if(start_va_shr == 0 && (start_va_shr = vmaspace(myproc(), len, PGSIZE)) == 0)
+    return 0;
+  //map physical pages starting at start_va_shr
+  if(shm_from_allocuvm(pgdir, start_va_shr, pages, amount_pages, perm) < 0)
+    return 0;
   return start_va_shr;
 }
 
@@ -139,6 +214,9 @@ shm_allocuvm(pde_t *pgdir,char* pages[], uint amount_pages, int perm)
 //                for the kernel's instructions and r/o data
 //   data..KERNBASE+PHYSTOP: mapped to V2P(data)..PHYSTOP,
 //                                  rw data + free physical memory
+//   KSTACKBASE..: kernel stacks under guard pages, one page table
+//                shared by all page directories (see kstack.c)
+//   KINFO, KPINFO: read-only kernel info pages (see kinfo.h)
 //   0xfe000000..0: mapped direct (devices such as ioapic)
 //
 // The kernel allocates physical memory for its heap and for user memory
@@ -166,9 +244,8 @@ setupkvm(void)
   pde_t *pgdir;
   struct kmap *k;
 
-  if((pgdir = (pde_t*)kalloc()) == 0)
+  if((pgdir = (pde_t*)kalloc_zeroed(KM_PGTBL)) == 0)
     return 0;
-  memset(pgdir, 0, PGSIZE);
   if (P2V(PHYSTOP) > (void*)DEVSPACE)
     panic("PHYSTOP too high");
   for(k = kmap; k < &kmap[NELEM(kmap)]; k++)
@@ -177,6 +254,7 @@ setupkvm(void)
       freevm(pgdir);
       return 0;
     }
+  pgdir[PDX(KSTACKBASE)] = V2P(kstackpt) | PTE_P | PTE_W;
   return pgdir;
 }
 
@@ -185,16 +263,87 @@ setupkvm(void)
 void
 kvmalloc(void)
 {
+  if((kinfo = (struct kinfo*)kalloc_zeroed(KM_KINFO)) == 0)
+    panic("kvmalloc: kinfo");
+  if((kstackpt = (pte_t*)kalloc_zeroed(KM_PGTBL)) == 0)
+    panic("kvmalloc: kstackpt");
   kpgdir = setupkvm();
-  switchkvm();
+  lcr3(V2P(kpgdir));  // mycpu() does not work yet
+}
+
+// Back the kernel stack page at va (see kstack.c) with memory,
+// if it is not already.  The page table is shared, so this maps
+// it in every page directory.
+int
+kstackmap(uint va)
+{
+  char *mem;
+
+  if(kstackpt[PTX(va)] & PTE_P)
+    return 0;
+  if((mem = kalloc(KM_KSTACK)) == 0)
+    return -1;
+  kstackpt[PTX(va)] = V2P(mem) | PTE_P | PTE_W;
+  return 0;
+}
+
+// Map the shared and the per-process kernel info pages into
+// pgdir.  They sit above KERNBASE, so freevm() leaves them alone.
+int
+setupkinfo(pde_t *pgdir, struct proc *p)
+{
+  if(mappages(pgdir, (void*)KINFO, PGSIZE, V2P(kinfo), PTE_U) < 0)
+    return -1;
+  if(mappages(pgdir, (void*)KPINFO, PGSIZE, V2P(p->kpinfo), PTE_U) < 0)
+    return -1;
+  return 0;
+}
+
+// Called by cpu 0 on every timer tick, with tickslock held.
+// Over the first few ticks, measure how many TSC cycles a tick
+// lasts so user code can interpolate between ticks (see
+// fineuptime in ulib.c).  ticktsc is written before ticks, so
+// a reader that sees ticks unchanged around it has a matching pair.
+void
+kinfotick(void)
+{
+  static uint64 tscbase;
+  uint64 tsc;
+
+  tsc = rdtsc();
+  if(ticks == 1)
+    tscbase = tsc;
+  else if(ticks == 1 + (1<<KCALSHIFT))
+    kinfo->tickcycles = (tsc - tscbase) >> KCALSHIFT;
+  kinfo->ticktsc = tsc;
+  kinfo->ticks = ticks;
+}
+
+// Load page directory pa into %cr3, unless it is there already:
+// every load flushes the TLB.  A CPU keeps the page table of the
+// process it last ran while the scheduler looks for the next one
+// under ptable.lock, so a switch to another process costs one
+// load, not two.  Code that changes the current page table
+// flushes with lcr3() itself.
+static void
+setcr3(uint pa)
+{
+  pushcli();
+  if(mycpu()->cr3 != pa){
+    lcr3(pa);
+    mycpu()->cr3 = pa;
+  }
+  popcli();
 }
 
 // Switch h/w page table register to the kernel-only page table,
-// for when no process is running.
+// for when no process is running.  The scheduler does this before
+// it lets go of ptable.lock, after which the last process's page
+// table may be freed.
 void
 switchkvm(void)
 {
-  lcr3(V2P(kpgdir));   // switch to the kernel page table
+  setcr3(V2P(kpgdir));   // switch to the kernel page table
 }
 
 // Switch TSS and h/w page table to correspond to process p.
@@ -209,19 +358,63 @@ switchuvm(struct proc *p)
     panic("switchuvm: no pgdir");
 
   pushcli();
-  mycpu()->gdt[SEG_TSS] = SEG16(STS_T32A, &mycpu()->ts,
-                                sizeof(mycpu()->ts)-1, 0);
-  mycpu()->gdt[SEG_TSS].s = 0;
-  mycpu()->ts.ss0 = SEG_KDATA << 3;
   mycpu()->ts.esp0 = (uint)p->kstack + KSTACKSIZE;
-  // setting IOPL=0 in eflags *and* iomb beyond the tss segment limit
-  // forbids I/O instructions (e.g., inb and outb) from user space
-  mycpu()->ts.iomb = (ushort) 0xFFFF;
-  ltr(SEG_TSS << 3);
-  lcr3(V2P(p->pgdir));  // switch to process's address space
+  setcr3(V2P(p->pgdir));  // switch to process's address space
+  p->kpinfo->cpu = cpuid();
   popcli();
 }
 
+// Superpages: a process that asks for them with superpages()
+// gets its heap in 4MB pages where it can, one page directory
+// entry with PTE_PS mapping a physically contiguous block from
+// kalloc_pages().  That saves the page table and most TLB
+// misses.  A superpage is only made for a 4MB-aligned stretch
+// of heap with nothing mapped in it yet, on the first touch.
+// It is copied, not shared, on fork, and never paged out.
+// Unmapping part of one splits it into 4KB pages first.
+// Shared memory segments use superpages too, marked PTE_SHM:
+// their pages are counted one by one, so they are dropped
+// one by one rather than freed as a block.
+#define SUPERORDER 10  // kalloc_pages order of a superpage
+
+// Map a zeroed superpage over va, if the heap around it allows.
+static int
+superfault(struct proc *p, uint va)
+{
+  uint a;
+  char *mem;
+
+  a = va & ~(SUPERPGSIZE-1);
+  if(a + SUPERPGSIZE > p->sz || p->pgdir[PDX(a)] != 0 ||
+     vmaoverlap(p, a, a + SUPERPGSIZE))
+    return -1;
+  if((mem = kalloc_pages(SUPERORDER, KM_USER)) == 0)
+    return -1;
+  memset(mem, 0, SUPERPGSIZE);
+  p->pgdir[PDX(a)] = V2P(mem) | PTE_PS | PTE_P | PTE_W | PTE_U;
+  return 0;
+}
+
+// Replace the superpage at *pde by a page table mapping the same
+// memory in 4KB pages.  The caller flushes the TLB.
+static int
+splitsuper(pde_t *pde)
+{
+  pte_t *pgtab;
+  uint pa, flags, i;
+
+  if((pgtab = (pte_t*)kalloc(KM_PGTBL)) == 0)
+    return -1;
+  pa = PTE_ADDR(*pde);
+  flags = PTE_FLAGS(*pde) & ~(PTE_PS|PTE_SHM);
+  if(!(*pde & PTE_SHM))
+    ksplit(P2V(pa), SUPERORDER);
+  for(i = 0; i < NPTENTRIES; i++)
+    pgtab[i] = (pa + i*PGSIZE) | flags;
+  *pde = V2P(pgtab) | PTE_P | PTE_W | PTE_U;
+  return 0;
+}
+
 // Load the initcode into address 0 of pgdir.
 // sz must be less than a page.
 void
@@ -231,8 +424,7 @@ inituvm(pde_t *pgdir, char *init, uint sz)
 
   if(sz >= PGSIZE)
     panic("inituvm: more than a page");
-  mem = kalloc();
-  memset(mem, 0, PGSIZE);
+  mem = kalloc_zeroed(KM_USER);
   mappages(pgdir, 0, PGSIZE, V2P(mem), PTE_W|PTE_U);
   memmove(mem, init, sz);
 }
@@ -276,13 +468,12 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 
   a = PGROUNDUP(oldsz);
   for(; a < newsz; a += PGSIZE){
-    mem = kalloc();
+    mem = kalloc_zeroed(KM_USER);
     if(mem == 0){
       cprintf("allocuvm out of memory\n");
       deallocuvm(pgdir, newsz, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
     if(mappages(pgdir, (char*)a, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
       cprintf("allocuvm out of memory (2)\n");
       deallocuvm(pgdir, newsz, oldsz);
@@ -301,13 +492,33 @@ int
 deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 {
   pte_t *pte;
-  uint a, pa;
+  pde_t *pde;
+  uint a, pa, i;
 
   if(newsz >= oldsz)
     return oldsz;
 
   a = PGROUNDUP(newsz);
   for(; a  < oldsz; a += PGSIZE){
+    pde = &pgdir[PDX(a)];
+    if(*pde & PTE_PS){
+      if(a % SUPERPGSIZE == 0 && a + SUPERPGSIZE <= oldsz){
+        if(*pde & PTE_SHM){
+          for(i = 0; i < NPTENTRIES; i++)
+            kfree(P2V(PTE_ADDR(*pde) + i*PGSIZE));
+        } else
+          kfree_pages(P2V(PTE_ADDR(*pde)), SUPERORDER);
+        *pde = 0;
+        a += SUPERPGSIZE - PGSIZE;
+        continue;
+      }
+      // Keep the superpage whole if it cannot be split; it
+      // goes when the rest of it does.
+      if(splitsuper(pde) < 0){
+        a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
+        continue;
+      }
+    }
     pte = walkpgdir(pgdir, (char*)a, 0);
     if(!pte)
       a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
@@ -318,6 +529,9 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
       char *v = P2V(pa);
       kfree(v);
       *pte = 0;
+    } else if(*pte & PTE_SWAP){
+      swapput(PTE_ADDR(*pte) >> PTXSHIFT);
+      *pte = 0;
     }
   }
   return newsz;
@@ -334,6 +548,8 @@ freevm(pde_t *pgdir)
     panic("freevm: no pgdir");
   deallocuvm(pgdir, KERNBASE, 0);
   for(i = 0; i < NPDENTRIES; i++){
+    if(i == PDX(KSTACKBASE))
+      continue;  // shared
     if(pgdir[i] & PTE_P){
       char * v = P2V(PTE_ADDR(pgdir[i]));
       kfree(v);
@@ -356,36 +572,291 @@ clearpteu(pde_t *pgdir, char *uva)
 }
 
 // Given a parent process's page table, create a copy
-// of it for a child.
+// of it for a child.  The pages themselves are shared: writable
+// ones become read-only copy-on-write pages in both page tables,
+// and cowfault() copies them when either side writes.
+// pgdir must be the current page table.
 pde_t*
 copyuvm(pde_t *pgdir, uint sz)
 {
   pde_t *d;
-  pte_t *pte;
-  uint pa, i, flags;
-  char *mem;
 
   if((d = setupkvm()) == 0)
     return 0;
-  for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
+  if(copyuvmrange(pgdir, d, 0, sz) < 0){
+    lcr3(V2P(pgdir));
+    freevm(d);
+    return 0;
+  }
+  lcr3(V2P(pgdir));  // flush the parent's stale writable TLB entries
+  return d;
+}
+
+// Share the pages of pgdir in [start, end) with d, making
+// writable ones copy-on-write in both.  The caller flushes
+// pgdir's TLB entries.
+int
+copyuvmrange(pde_t *pgdir, pde_t *d, uint start, uint end)
+{
+  pte_t *pte, *npte;
+  pde_t *pde;
+  uint pa, i, flags;
+  char *mem;
+
+  for(i = start; i < end; i += PGSIZE){
+    pde = &pgdir[PDX(i)];
+    if(*pde & PTE_PS){
+      if(!(*pde & PTE_SHM) &&
+         (mem = kalloc_pages(SUPERORDER, KM_USER)) != 0){
+        memmove(mem, P2V(PTE_ADDR(*pde)), SUPERPGSIZE);
+        d[PDX(i)] = V2P(mem) | PTE_FLAGS(*pde);
+        i += SUPERPGSIZE - PGSIZE;
+        continue;
+      }
+      // No 4MB block is free, or it is shared memory whose
+      // pages are counted one by one: share it page by page.
+      if(splitsuper(pde) < 0)
+        return -1;
+    }
+    // Heap pages that were never touched stay that way.
+    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0){
+      i = PGADDR(PDX(i) + 1, 0, 0) - PGSIZE;
+      continue;
+    }
+    if(*pte & PTE_SWAP){
+      // Each gets its own copy when it swaps the page in.
+      if((npte = walkpgdir(d, (void *) i, 1)) == 0)
+        return -1;
+      *npte = *pte;
+      swapdup(PTE_ADDR(*pte) >> PTXSHIFT);
+      continue;
+    }
     if(!(*pte & PTE_P))
-      panic("copyuvm: page not present");
+      continue;
+    if(*pte & PTE_W)
+      *pte = (*pte & ~PTE_W) | PTE_COW;
     pa = PTE_ADDR(*pte);
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
-      goto bad;
-    memmove(mem, (char*)P2V(pa), PGSIZE);
-    if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0) {
-      kfree(mem);
-      goto bad;
+    if(mappages(d, (void*)i, PGSIZE, pa, flags) < 0)
+      return -1;
+    kref(P2V(pa));
+  }
+  return 0;
+}
+
+// Map the page mem at user address va.  The mapping takes over
+// the caller's reference to mem.
+int
+mapupage(pde_t *pgdir, uint va, char *mem, int perm)
+{
+  return mappages(pgdir, (char*)va, PGSIZE, V2P(mem), perm);
+}
+
+// Map a zeroed page at va, the first touch of memory that
+// growproc() only reserved, or a superpage if p wants them.
+static int
+lazyfault(struct proc *p, uint va)
+{
+  pde_t *pgdir = p->pgdir;
+  pte_t *pte;
+  char *mem;
+
+  if(p->superpages && superfault(p, va) == 0)
+    return 0;
+  va = PGROUNDDOWN(va);
+  if((pte = walkpgdir(pgdir, (char*)va, 0)) != 0 && (*pte & PTE_P))
+    return -1;
+  if((mem = kalloc_zeroed(KM_USER)) == 0)
+    return FAULT_NOMEM;
+  if(mappages(pgdir, (char*)va, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
+    kfree(mem);
+    return FAULT_NOMEM;
+  }
+  return 0;
+}
+
+// Read back a page that swap.c paged out.
+static int
+swapfault(pte_t *pte)
+{
+  char *mem;
+  uint s;
+
+  s = PTE_ADDR(*pte) >> PTXSHIFT;
+  if((mem = kalloc(KM_USER)) == 0)
+    return FAULT_NOMEM;
+  swapread(mem, s);
+  *pte = V2P(mem) | (PTE_FLAGS(*pte) & ~PTE_SWAP) | PTE_P;
+  swapput(s);
+  return 0;
+}
+
+static int
+pagefault1(struct proc *p, uint va, uint err)
+{
+  pte_t *pte;
+
+  if(va < KERNBASE && (pte = walkpgdir(p->pgdir, (char*)va, 0)) != 0 &&
+     (*pte & PTE_SWAP))
+    return swapfault(pte);
+  if(va >= p->sz || vmaoverlap(p, va, va + 1))
+    return vmafault(p, va, err);
+  if((err & FEC_PR) == 0)
+    return lazyfault(p, va);
+  if(err & FEC_WR)
+    return cowfault(p->pgdir, va);
+  return -1;
+}
+
+// Resolve a page fault at va in p's address space, if it is
+// one the kernel takes on purpose.  Returns -1 otherwise.
+int
+pagefault(struct proc *p, uint va, uint err)
+{
+  int try, r;
+
+  for(try = 0; (r = pagefault1(p, va, err)) < 0; try++){
+    // If memory is short, wait for kswapd to page some out,
+    // or failing that for the OOM killer's victim to exit,
+    // unless a spinlock is held and we may not sleep.  (Faults
+    // run with interrupts off; a system call with them on holds
+    // no spinlock.)  Any other failure is a bad access.
+    if(r != FAULT_NOMEM || p->killed ||
+       (!(readeflags() & FL_IF) && mycpu()->ncli > 0) ||
+       (swapwait(try) < 0 && oomkill(p, try) < 0))
+      return -1;
+  }
+  return 0;
+}
+
+// Bring in the pages of [va, va+n), and if write is set, break
+// their copy-on-write sharing, so that using them cannot fault.
+// A system call does this for its buffers before it takes any
+// locks: a fault may sleep for the disk or for memory, and
+// with a spinlock held it may not, and fails.
+int
+prefault(struct proc *p, uint va, uint n, int write)
+{
+  pte_t *pte;
+  uint a;
+
+  for(a = PGROUNDDOWN(va); a < va + n; a += PGSIZE){
+    if(p->pgdir[PDX(a)] & PTE_PS)
+      continue;
+    pte = walkpgdir(p->pgdir, (char*)a, 0);
+    if((pte == 0 || (*pte & PTE_P) == 0) &&
+       pagefault(p, a, write ? FEC_WR : 0) < 0)
+      return -1;
+    if(write && (pte = walkpgdir(p->pgdir, (char*)a, 0)) != 0 &&
+       (*pte & PTE_COW) && pagefault(p, a, FEC_PR|FEC_WR) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+// Count the resident pages below sz.
+uint
+rsspages(pde_t *pgdir, uint sz)
+{
+  pte_t *pte;
+  uint a, n;
+
+  n = 0;
+  for(a = 0; a < sz; a += PGSIZE){
+    if(pgdir[PDX(a)] & PTE_PS){
+      n += NPTENTRIES;
+      a += SUPERPGSIZE - PGSIZE;
+    } else if((pte = walkpgdir(pgdir, (char*)a, 0)) == 0)
+      a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
+    else if(*pte & PTE_P)
+      n++;
+  }
+  return n;
+}
+
+// Is any page in [start, end) mapped, or paged out?
+int
+uvmmapped(pde_t *pgdir, uint start, uint end)
+{
+  pte_t *pte;
+  uint a;
+
+  for(a = PGROUNDDOWN(start); a < end; a += PGSIZE){
+    if(pgdir[PDX(a)] & PTE_PS)
+      return 1;
+    if((pte = walkpgdir(pgdir, (char*)a, 0)) == 0)
+      a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
+    else if(*pte & (PTE_P|PTE_SWAP))
+      return 1;
+  }
+  return 0;
+}
+
+// Return the PTE for user address va, or 0 if its page table
+// does not exist or va is in a superpage.  For swap.c.
+pte_t*
+uvmpte(pde_t *pgdir, uint va)
+{
+  return walkpgdir(pgdir, (char*)va, 0);
+}
+
+// Count the user pages of pgdir that are in memory and in swap,
+// and the page table pages, for memstat.  pgdir may belong to a
+// process running on another CPU, so entries are checked before
+// they are followed; the counts are only a snapshot.
+void
+uvmusage(pde_t *pgdir, struct procmemstat *ps)
+{
+  pte_t *pgtab;
+  uint i, j;
+
+  ps->rss = ps->swap = 0;
+  ps->pgtbl = 1;
+  for(i = 0; i < PDX(KERNBASE); i++){
+    if(!(pgdir[i] & PTE_P) || PTE_ADDR(pgdir[i]) >= PHYSTOP)
+      continue;
+    if(pgdir[i] & PTE_PS){
+      ps->rss += NPTENTRIES;
+      continue;
+    }
+    ps->pgtbl++;
+    pgtab = (pte_t*)P2V(PTE_ADDR(pgdir[i]));
+    for(j = 0; j < NPTENTRIES; j++){
+      if(pgtab[j] & PTE_P)
+        ps->rss++;
+      else if(pgtab[j] & PTE_SWAP)
+        ps->swap++;
     }
   }
-  return d;
+}
 
-bad:
-  freevm(d);
+// Handle a write to user address va in pgdir.  If the page is
+// copy-on-write, give pgdir a private writable copy of it, or
+// simply make it writable again if nobody else maps it.
+// Returns -1 if va is not a copy-on-write page, or FAULT_NOMEM
+// if memory is short.
+int
+cowfault(pde_t *pgdir, uint va)
+{
+  pte_t *pte;
+  uint pa, flags;
+  char *mem;
+
+  if(va >= KERNBASE || (pte = walkpgdir(pgdir, (char*)va, 0)) == 0)
+    return -1;
+  if((*pte & (PTE_P|PTE_U|PTE_COW)) != (PTE_P|PTE_U|PTE_COW))
+    return -1;
+  pa = PTE_ADDR(*pte);
+  flags = (PTE_FLAGS(*pte) | PTE_W) & ~PTE_COW;
+  if(krefcount(P2V(pa)) > 1){
+    if((mem = kalloc(KM_USER)) == 0)
+      return FAULT_NOMEM;
+    memmove(mem, P2V(pa), PGSIZE);
+    *pte = V2P(mem) | flags;
+    kfree(P2V(pa));
+  } else
+    *pte = pa | flags;
+  invlpg((void*)va);
   return 0;
 }
 
@@ -394,10 +865,17 @@ bad:
 char*
 uva2ka(pde_t *pgdir, char *uva)
 {
+  pde_t *pde;
   pte_t *pte;
 
+  pde = &pgdir[PDX(uva)];
+  if(*pde & PTE_PS){
+    if((*pde & PTE_U) == 0)
+      return 0;
+    return (char*)P2V(PTE_ADDR(*pde) + PGROUNDDOWN((uint)uva % SUPERPGSIZE));
+  }
   pte = walkpgdir(pgdir, uva, 0);
-  if((*pte & PTE_P) == 0)
+  if(pte == 0 || (*pte & PTE_P) == 0)
     return 0;
   if((*pte & PTE_U) == 0)
     return 0;
@@ -412,10 +890,16 @@ copyout(pde_t *pgdir, uint va, void *p, uint len)
 {
   char *buf, *pa0;
   uint n, va0;
+  pte_t *pte;
 
   buf = (char*)p;
   while(len > 0){
     va0 = (uint)PGROUNDDOWN(va);
+    // The kernel mapping ignores PTE_W, so break
+    // copy-on-write sharing by hand.
+    pte = walkpgdir(pgdir, (char*)va0, 0);
+    if(pte && (*pte & PTE_COW) && cowfault(pgdir, va0) < 0)
+      return -1;
     pa0 = uva2ka(pgdir, (char*)va0);
     if(pa0 == 0)
       return -1;
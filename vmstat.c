@@ -0,0 +1,39 @@
+// vmstat: report paging activity.
+// Usage: vmstat [interval] [count]
+// Prints one line every interval ticks (default: once).  The
+// first line counts events since boot, later ones since the
+// line before, like the Unix tool.
+
+#include "types.h"
+#include "param.h"
+#include "stat.h"
+#include "user.h"
+#include "memstat.h"
+
+struct memstat cur, last;
+
+int
+main(int argc, char *argv[])
+{
+  int i, interval, count;
+
+  interval = argc > 1 ? atoi(argv[1]) : 0;
+  count = argc > 2 ? atoi(argv[2]) : (interval > 0 ? -1 : 1);
+
+  printf(1, "FREE\tZPOOL\tPCACHE\tSWAP\tSWPUSED\tPI\tPO\tSCAN\tREFS\tWAITS\n");
+  for(i = 0; count < 0 || i < count; i++){
+    if(i > 0)
+      sleep(interval);
+    if(memstat(&cur) < 0){
+      printf(2, "vmstat: memstat failed\n");
+      exit();
+    }
+    printf(1, "%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n",
+           cur.freepages, cur.zpool, cur.pcpages, cur.swaptotal, cur.swapused,
+           cur.pageins - last.pageins, cur.pageouts - last.pageouts,
+           cur.scans - last.scans, cur.refs - last.refs,
+           cur.swapwaits - last.swapwaits);
+    last = cur;
+  }
+  exit();
+}